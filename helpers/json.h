@@ -1,9 +1,52 @@
 #pragma once 
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <string>
+#include <shared_mutex>
 #include <sstream>
+#include <system_error>
+#include <stdexcept>
+#include <limits>
+#include <tuple>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
+
+#if (defined __unix__) || (defined __APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* SIMD support used by the parser. Defining JSON_NO_SIMD disables the vectorized code paths in favor of their scalar fallbacks. 
+ */
+#if (! defined JSON_NO_SIMD)
+#if (defined __AVX2__)
+#define JSON_SIMD_AVX2
+#include <immintrin.h>
+#elif (defined __SSE2__) || (defined _M_X64) || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define JSON_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+#if (defined _MSC_VER)
+#include <intrin.h>
+#endif
 
 #include "helpers.h"
 
@@ -37,70 +80,559 @@ namespace json {
     }; // json::Error
 
     class Value;
+    class Reader;
+    class Lazy;
+    class ValueBuilder;
+    template<typename HANDLER = ValueBuilder> class ChunkedParser;
 
     std::ostream & operator << (std::ostream &, Value const &);
 
+    namespace detail {
+
+        /** Returns the index of the least significant set bit. The argument must not be zero. 
+         */
+        inline unsigned countTrailingZeros(uint64_t x) {
+#if (defined _MSC_VER) && (defined _WIN64)
+            unsigned long result;
+            _BitScanForward64(&result, x);
+            return static_cast<unsigned>(result);
+#elif (defined _MSC_VER)
+            unsigned long result;
+            if (_BitScanForward(&result, static_cast<unsigned long>(x)))
+                return static_cast<unsigned>(result);
+            _BitScanForward(&result, static_cast<unsigned long>(x >> 32));
+            return static_cast<unsigned>(result) + 32;
+#else
+            return static_cast<unsigned>(__builtin_ctzll(x));
+#endif
+        }
+
+        /** Returns the index of the most significant set bit. The argument must not be zero. 
+         */
+        inline unsigned highestBit(uint64_t x) {
+#if (defined _MSC_VER) && (defined _WIN64)
+            unsigned long result;
+            _BitScanReverse64(&result, x);
+            return static_cast<unsigned>(result);
+#elif (defined _MSC_VER)
+            unsigned long result;
+            if (_BitScanReverse(&result, static_cast<unsigned long>(x >> 32)))
+                return static_cast<unsigned>(result) + 32;
+            _BitScanReverse(&result, static_cast<unsigned long>(x));
+            return static_cast<unsigned>(result);
+#else
+            return 63 - static_cast<unsigned>(__builtin_clzll(x));
+#endif
+        }
+
+        inline bool isWhitespace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+        /** Returns a bitmap of whitespace characters in the 64 bytes starting at p, one bit per byte. 
+         */
+        inline uint64_t whitespaceMaskScalar(char const * p) {
+            uint64_t result = 0;
+            for (unsigned i = 0; i < 64; ++i)
+                if (isWhitespace(p[i]))
+                    result |= uint64_t{1} << i;
+            return result;
+        }
+
+        /** Returns a bitmap of whitespace characters in the 64 bytes starting at p, one bit per byte. 
+         
+            Uses AVX2 or SSE2 when available. 
+         */
+        inline uint64_t whitespaceMask(char const * p) {
+#if (defined JSON_SIMD_AVX2)
+            __m256i const space = _mm256_set1_epi8(' ');
+            __m256i const tab = _mm256_set1_epi8('\t');
+            __m256i const lf = _mm256_set1_epi8('\n');
+            __m256i const cr = _mm256_set1_epi8('\r');
+            uint64_t result = 0;
+            for (unsigned i = 0; i < 64; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + i));
+                __m256i ws = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr))
+                );
+                result |= uint64_t{static_cast<uint32_t>(_mm256_movemask_epi8(ws))} << i;
+            }
+            return result;
+#elif (defined JSON_SIMD_SSE2)
+            __m128i const space = _mm_set1_epi8(' ');
+            __m128i const tab = _mm_set1_epi8('\t');
+            __m128i const lf = _mm_set1_epi8('\n');
+            __m128i const cr = _mm_set1_epi8('\r');
+            uint64_t result = 0;
+            for (unsigned i = 0; i < 64; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + i));
+                __m128i ws = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr))
+                );
+                result |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(ws))} << i;
+            }
+            return result;
+#else
+            return whitespaceMaskScalar(p);
+#endif
+        }
+
+        /** Returns pointer to the first occurence of the delimiter or a backslash in the given range, or end if there is none. 
+         
+            Uses AVX2 or SSE2 when available. 
+         */
+        inline char const * findDelimiterOrEscape(char const * p, char const * end, char delimiter) {
+#if (defined JSON_SIMD_AVX2)
+            __m256i const delim = _mm256_set1_epi8(delimiter);
+            __m256i const escape = _mm256_set1_epi8('\\');
+            while (end - p >= 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p));
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, delim), _mm256_cmpeq_epi8(v, escape))));
+                if (mask != 0)
+                    return p + countTrailingZeros(mask);
+                p += 32;
+            }
+#elif (defined JSON_SIMD_SSE2)
+            __m128i const delim = _mm_set1_epi8(delimiter);
+            __m128i const escape = _mm_set1_epi8('\\');
+            while (end - p >= 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, delim), _mm_cmpeq_epi8(v, escape))));
+                if (mask != 0)
+                    return p + countTrailingZeros(mask);
+                p += 16;
+            }
+#endif
+            while (p != end && *p != delimiter && *p != '\\')
+                ++p;
+            return p;
+        }
+
+        /** Returns true if the character must be escaped in a JSON string, i.e. quotes, backslashes and control characters. 
+         */
+        inline bool needsEscape(char c) { return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20; }
+
+        /** Returns pointer to the first character in the given range that must be escaped in a JSON string, or end if there is none. 
+         
+            Uses AVX2 or SSE2 when available. Control characters are found as bytes whose unsigned maximum with 0x1f is 0x1f. 
+         */
+        inline char const * findEscape(char const * p, char const * end) {
+#if (defined JSON_SIMD_AVX2)
+            __m256i const quote = _mm256_set1_epi8('"');
+            __m256i const escape = _mm256_set1_epi8('\\');
+            __m256i const control = _mm256_set1_epi8(0x1f);
+            while (end - p >= 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p));
+                __m256i x = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, escape)),
+                    _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control)
+                );
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(x));
+                if (mask != 0)
+                    return p + countTrailingZeros(mask);
+                p += 32;
+            }
+#elif (defined JSON_SIMD_SSE2)
+            __m128i const quote = _mm_set1_epi8('"');
+            __m128i const escape = _mm_set1_epi8('\\');
+            __m128i const control = _mm_set1_epi8(0x1f);
+            while (end - p >= 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+                __m128i x = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, escape)),
+                    _mm_cmpeq_epi8(_mm_max_epu8(v, control), control)
+                );
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(x));
+                if (mask != 0)
+                    return p + countTrailingZeros(mask);
+                p += 16;
+            }
+#endif
+            while (p != end && ! needsEscape(*p))
+                ++p;
+            return p;
+        }
+
+        /** Appends the UTF-8 encoding of the given code point to the string. 
+         */
+        inline void appendUtf8(std::string & s, uint32_t cp) {
+            if (cp < 0x80) {
+                s += static_cast<char>(cp);
+            } else if (cp < 0x800) {
+                s += static_cast<char>(0xc0 | (cp >> 6));
+                s += static_cast<char>(0x80 | (cp & 0x3f));
+            } else if (cp < 0x10000) {
+                s += static_cast<char>(0xe0 | (cp >> 12));
+                s += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+                s += static_cast<char>(0x80 | (cp & 0x3f));
+            } else {
+                s += static_cast<char>(0xf0 | (cp >> 18));
+                s += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+                s += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+                s += static_cast<char>(0x80 | (cp & 0x3f));
+            }
+        }
+
+        inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+        /** Returns true for characters that may appear in a number. 
+         */
+        inline bool isNumberChar(char c) { return isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'; }
+
+        /** Result of parsing a number, either a 64-bit integer, an unsigned 64-bit integer that does not fit the signed one, or a double. 
+         */
+        struct Number {
+            enum class Kind {
+                Int, 
+                UInt,
+                Double,
+            }; // json::detail::Number::Kind
+
+            Kind kind;
+            union {
+                int64_t valueInt;
+                uint64_t valueUInt;
+                double valueDouble;
+            };
+        }; // json::detail::Number
+
+        /** Converts the number in given range to double with correct rounding. 
+         
+            Uses std::from_chars where the standard library supports it for floating point values, std::strtod otherwise. The range must not contain the sign. 
+         */
+        inline double parseDoubleSlow(char const * begin, char const * end) {
+#if (defined __cpp_lib_to_chars)
+            double result;
+            auto r = std::from_chars(begin, end, result);
+            if (r.ec == std::errc{} && r.ptr == end)
+                return result;
+            // out of range values are left to strtod which returns infinity or zero as appropriate
+#endif
+            std::string s{begin, end};
+            return std::strtod(s.c_str(), nullptr);
+        }
+
+        /** Parses number at the beginning of the given range and returns pointer to the first character after it, or nullptr if there is no valid number. 
+         
+            Any number of leading minus signs is accepted, each negating the value. Integers are parsed exactly into 64 bits. Integers outside of the int64 range and numbers with fraction or exponent are returned as doubles. Doubles with at most 19 significant digits and small exponents are calculated exactly using the fast path described by Clinger (exact mantissa multiplied or divided by an exact power of ten), other values are converted by parseDoubleSlow(). 
+         */
+        inline char const * parseNumber(char const * p, char const * end, Number & result) {
+            static constexpr double powersOfTen[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+            static constexpr uint64_t maxExactMantissa = uint64_t{1} << 53;
+            bool neg = false;
+            while (p != end && *p == '-') {
+                neg = ! neg;
+                ++p;
+            }
+            char const * start = p;
+            // mantissa, counting significant digits only (leading zeros do not count)
+            uint64_t m = 0;
+            size_t digits = 0;
+            while (p != end && isDigit(*p)) {
+                if (m != 0 || *p != '0') {
+                    m = m * 10 + static_cast<uint64_t>(*p - '0');
+                    ++digits;
+                }
+                ++p;
+            }
+            if (p == start)
+                return nullptr;
+            bool isInt = true;
+            int64_t exp10 = 0;
+            if (p != end && *p == '.') {
+                isInt = false;
+                ++p;
+                while (p != end && isDigit(*p)) {
+                    if (m != 0 || *p != '0') {
+                        m = m * 10 + static_cast<uint64_t>(*p - '0');
+                        ++digits;
+                    }
+                    --exp10;
+                    ++p;
+                }
+            }
+            if (p != end && (*p == 'e' || *p == 'E')) {
+                isInt = false;
+                ++p;
+                bool expNeg = false;
+                if (p != end && (*p == '+' || *p == '-'))
+                    expNeg = (*p++ == '-');
+                if (p == end || ! isDigit(*p))
+                    return nullptr;
+                int64_t e = 0;
+                while (p != end && isDigit(*p)) {
+                    if (e < 100000) 
+                        e = e * 10 + (*p - '0');
+                    ++p;
+                }
+                exp10 += expNeg ? -e : e;
+            }
+            // the mantissa has overflown, the slow path will deal with it, unless the number is an integer that still fits 64 bits unsigned
+            if (digits > 19) {
+                if (isInt && ! neg && digits == 20 && std::from_chars(start, p, result.valueUInt).ec == std::errc{}) {
+                    result.kind = Number::Kind::UInt;
+                    return p;
+                }
+                result.kind = Number::Kind::Double;
+                result.valueDouble = parseDoubleSlow(start, p);
+                if (neg)
+                    result.valueDouble = -result.valueDouble;
+                return p;
+            }
+            if (isInt) {
+                if (neg ? (m <= uint64_t{1} << 63) : (m <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))) {
+                    result.kind = Number::Kind::Int;
+                    result.valueInt = neg ? static_cast<int64_t>(0 - m) : static_cast<int64_t>(m);
+                } else if (! neg) {
+                    result.kind = Number::Kind::UInt;
+                    result.valueUInt = m;
+                } else {
+                    // conversion from integer to double is correctly rounded
+                    result.kind = Number::Kind::Double;
+                    result.valueDouble = - static_cast<double>(m);
+                }
+                return p;
+            }
+            result.kind = Number::Kind::Double;
+            if (m == 0) {
+                result.valueDouble = neg ? -0.0 : 0.0;
+                return p;
+            }
+            if (m <= maxExactMantissa) {
+                if (exp10 >= -22 && exp10 <= 22) {
+                    double d = static_cast<double>(m);
+                    d = exp10 < 0 ? d / powersOfTen[-exp10] : d * powersOfTen[exp10];
+                    result.valueDouble = neg ? -d : d;
+                    return p;
+                }
+                // large exponent, but the mantissa has few digits, so part of the exponent can be moved to the mantissa exactly
+                if (exp10 > 22 && exp10 <= 22 + 18) {
+                    for (int64_t i = exp10; i > 22 && m <= maxExactMantissa; --i)
+                        m *= 10;
+                    if (m <= maxExactMantissa) {
+                        double d = static_cast<double>(m) * powersOfTen[22];
+                        result.valueDouble = neg ? -d : d;
+                        return p;
+                    }
+                }
+            }
+            result.valueDouble = parseDoubleSlow(start, p);
+            if (neg)
+                result.valueDouble = -result.valueDouble;
+            return p;
+        }
+
+    } // namespace json::detail
+
+    /** Kinds of JSON values. 
+     */
+    enum class Kind : uint8_t {
+        Undefined, 
+        Null, 
+        Bool, 
+        Int,
+        Int64,
+        UInt64,
+        Double,
+        String,
+        Array,
+        Struct
+    }; // json::Kind
+
+    namespace detail {
+
+        /** Header shared by all value classes. 
+         
+            The header is the first member of every value class so that Value, which is a union of the value classes, can read the kind of the active one from any of them. It is a single byte, whose lower bits hold the kind and upper bits hold flags, one of which tells whether the value has a comment, while the others are class specific. 
+         */
+        class Header {
+        public:
+            explicit Header(Kind kind):
+                bits_{static_cast<uint8_t>(kind)} {
+            }
+
+            Kind kind() const { return static_cast<Kind>(bits_ & KindMask); }
+
+            /** Returns true if any of the given flags is set. 
+             */
+            bool has(uint8_t flags) const { return bits_ & flags; }
+
+            void set(uint8_t flags, bool value) { 
+                if (value)
+                    bits_ |= flags;
+                else
+                    bits_ &= ~flags;
+            }
+
+            bool commented() const { return has(Commented); }
+            void setCommented(bool value) { set(Commented, value); }
+
+            static constexpr uint8_t Commented = 0x10;
+
+        private:
+            static constexpr uint8_t KindMask = 0x0f;
+            static_assert(static_cast<uint8_t>(Kind::Struct) <= KindMask);
+
+            uint8_t bits_;
+        }; // json::detail::Header
+
+        /** Returns the comment of values without one. 
+         */
+        inline std::string const & noComment() {
+            static std::string const empty;
+            return empty;
+        }
+
+        /** Out of line part of a value that has a comment, which holds the comment and the payload it displaces from the value. 
+         */
+        template<typename T>
+        struct Annex {
+            std::string comment;
+            T value;
+        }; // json::detail::Annex
+
+        /** Payload of the undefined and null values. 
+         */
+        struct Nothing {
+        }; // json::detail::Nothing
+
+        /** Base of the scalar value classes. 
+         
+            The value is kept in the 8 bytes that follow the header. Comments are rare, so instead of a string in every value, setting a comment moves the value to an annex on the heap together with the comment, and the 8 bytes point to the annex instead. The header tells which of the two the value holds, so that values without comments never pay for them. 
+         */
+        template<typename T>
+        class Scalar {
+        public:
+            std::string const & comment() const { return header_.commented() ? annex_->comment : noComment(); }
+
+            void setComment(std::string_view comment) {
+                if (header_.commented()) {
+                    if (! comment.empty()) {
+                        annex_->comment = comment;
+                        return;
+                    }
+                    Annex<T> * annex = annex_;
+                    value_ = annex->value;
+                    header_.setCommented(false);
+                    delete annex;
+                } else if (! comment.empty()) {
+                    annex_ = new Annex<T>{std::string{comment}, value_};
+                    header_.setCommented(true);
+                }
+            }
+
+        protected:
+            friend class json::Value;
+
+            Scalar(Kind kind, T value):
+                header_{kind},
+                annex_{nullptr} {
+                // values smaller than the pointer, such as Nothing, leave the rest of it zeroed
+                value_ = value;
+            }
+
+            Scalar(Scalar const & from):
+                header_{from.header_.kind()},
+                value_{from.value()} {
+                setComment(from.comment());
+            }
+
+            Scalar(Scalar && from) noexcept:
+                header_{from.header_} {
+                steal(from);
+            }
+
+            ~Scalar() {
+                if (header_.commented())
+                    delete annex_;
+            }
+
+            Scalar & operator = (Scalar const & other) {
+                if (this != &other) {
+                    setComment(other.comment());
+                    (header_.commented() ? annex_->value : value_) = other.value();
+                }
+                return *this;
+            }
+
+            Scalar & operator = (Scalar && other) noexcept {
+                if (this != &other) {
+                    if (header_.commented())
+                        delete annex_;
+                    header_ = other.header_;
+                    steal(other);
+                }
+                return *this;
+            }
+
+            T value() const { return header_.commented() ? annex_->value : value_; }
+
+            Header header_;
+            union {
+                T value_;
+                Annex<T> * annex_;
+            };
+
+        private:
+            /** Takes the value and the comment of the other scalar, whose header has already been copied. The other scalar keeps its value, but loses the comment. 
+             */
+            void steal(Scalar & other) {
+                if (header_.commented()) {
+                    annex_ = other.annex_;
+                    other.value_ = annex_->value;
+                    other.header_.setCommented(false);
+                } else {
+                    value_ = other.value_;
+                }
+            }
+        }; // json::detail::Scalar
+
+    } // namespace json::detail
+
     /** The undefined value placeholder. 
      
         Does not contain any useful information apart from the optinal comment, exists for unified creation of values via constructors. 
      */
-    class Undefined {
+    class Undefined : public detail::Scalar<detail::Nothing> {
     public:
-        Undefined() = default;
-        std::string const & comment() const { return comment_; }
-        void setComment(std::string_view comment) { comment_ = comment; }
+        Undefined(): Scalar{Kind::Undefined, detail::Nothing{}} {}
     private:
+        friend class Value;
 
-        friend inline std::ostream & operator << (std::ostream & s, Undefined const & json) {
-            UNUSED(json);
-            s << "undefined";
-            return s;
-        }
-
-        std::string comment_;
+        friend std::ostream & operator << (std::ostream & s, Undefined const & json);
     }; // json::Undefined
 
     /** The Null value placeholder. 
 
         Does not contain any useful information apart from the optinal comment, exists for unified creation of values via constructors. 
      */
-    class Null {
+    class Null : public detail::Scalar<detail::Nothing> {
     public:
-        Null() = default;
-        std::string const & comment() const { return comment_; }
-        void setComment(std::string_view comment) { comment_ = comment; }
+        Null(): Scalar{Kind::Null, detail::Nothing{}} {}
     private:
-        friend inline std::ostream & operator << (std::ostream & s, Null const & json) {
-            UNUSED(json);
-            s << "null";
-            return s;
-        }
+        friend class Value;
 
-        std::string comment_;
+        friend std::ostream & operator << (std::ostream & s, Null const & json);
     }; // json::Null
 
     /** Boolean JSON value. 
      */
-    class Bool {
+    class Bool : public detail::Scalar<bool> {
     public:
-        explicit Bool(bool value):value_{value} {}
-
-        std::string const & comment() const { return comment_; }
-        void setComment(std::string_view comment) { comment_ = comment; }
+        explicit Bool(bool value): Scalar{Kind::Bool, value} {}
 
-        operator bool () const { return value_; } 
+        operator bool () const { return value(); } 
 
-        bool operator == (Bool const & other) const { return value_ == other.value_; }
-        bool operator != (Bool const & other) const { return value_ == other.value_; }
+        bool operator == (Bool const & other) const { return value() == other.value(); }
+        bool operator != (Bool const & other) const { return value() != other.value(); }
 
     private:
-        friend inline std::ostream & operator << (std::ostream & s, Bool const & json) {
-            s << (json.value_ ? "true" : "false");
-            return s;
-        }
+        friend class Value;
 
-        bool value_;
-        std::string comment_;
+        friend std::ostream & operator << (std::ostream & s, Bool const & json);
 
     }; // json::Boolean
 
@@ -108,321 +640,603 @@ namespace json {
      
         Contrary to JSON specification numbers are stored as either double, or boolean values. 
      */
-    class Int {
+    class Int : public detail::Scalar<int> {
     public:
-        explicit Int(int value):value_{value} {}
+        explicit Int(int value): Scalar{Kind::Int, value} {}
 
-        std::string const & comment() const { return comment_; }
-        void setComment(std::string_view comment) { comment_ = comment; }
-
-        operator int () const { return value_; }
+        operator int () const { return value(); }
 
-        bool operator == (Int const & other) const { return value_ == other.value_; }
-        bool operator != (Int const & other) const { return value_ == other.value_; }
+        bool operator == (Int const & other) const { return value() == other.value(); }
+        bool operator != (Int const & other) const { return value() != other.value(); }
 
     private:
-        friend inline std::ostream & operator << (std::ostream & s, Int const & json) {
-            s << json.value_;
-            return s;
-        }
+        friend class Value;
 
-        int value_;
-        std::string comment_;
+        friend std::ostream & operator << (std::ostream & s, Int const & json);
 
     }; // json::Integer
 
-    /** Double JSON value. 
+    /** 64-bit integer JSON value. 
      
-        Contrary to JSON specification numbers are stored as either double, or boolean values. 
+        Integers that do not fit into Int are parsed as Int64. 
      */
-    class Double {
+    class Int64 : public detail::Scalar<int64_t> {
     public:
-        explicit Double(double value):value_{value} {}
-
-        std::string const & comment() const { return comment_; }
-        void setComment(std::string_view comment) { comment_ = comment; }
+        explicit Int64(int64_t value): Scalar{Kind::Int64, value} {}
 
-        operator double () const { return value_; }
+        operator int64_t () const { return value(); }
 
-        bool operator == (Double const & other) const { return value_ == other.value_; }
-        bool operator != (Double const & other) const { return value_ == other.value_; }
+        bool operator == (Int64 const & other) const { return value() == other.value(); }
+        bool operator != (Int64 const & other) const { return value() != other.value(); }
 
     private:
+        friend class Value;
 
-        friend inline std::ostream & operator << (std::ostream & s, Double const & json) {
-            s << json.value_;
-            return s;
-        }
-
-        double value_;
-        std::string comment_;
+        friend std::ostream & operator << (std::ostream & s, Int64 const & json);
 
-    }; // json::Double
+    }; // json::Int64
 
-    /** String JSON value. 
+    /** Unsigned 64-bit integer JSON value. 
+     
+        Only integers that do not fit into Int64 are parsed as UInt64, so that their value is exact, while larger and negative integers that do not fit into Int64 are parsed as Double. 
      */
-    class String {
+    class UInt64 : public detail::Scalar<uint64_t> {
     public:
-        explicit String(std::string_view value):value_{value} {}
-        explicit String(char const * value):value_{value} {}
-        explicit String(std::string && value):value_{std::move(value)} {}
-
-        std::string const & comment() const { return comment_; }
-        void setComment(std::string_view comment) { comment_ = comment; }
+        explicit UInt64(uint64_t value): Scalar{Kind::UInt64, value} {}
 
-        size_t size() const { return value_.size(); }
-        char const * c_str() const { return value_.c_str(); }
+        operator uint64_t () const { return value(); }
 
-        bool operator == (String const & other) const { return value_ == other.value_; }
-        bool operator != (String const & other) const { return value_ == other.value_; }
+        bool operator == (UInt64 const & other) const { return value() == other.value(); }
+        bool operator != (UInt64 const & other) const { return value() != other.value(); }
 
     private:
-        friend inline std::ostream & operator << (std::ostream & s, String const & json) {
-            // TODO quote the string if necessary
-            s << '"' << json.value_ << '"';
-            return s;
-        }
+        friend class Value;
 
-        std::string value_;
-        std::string comment_;
+        friend std::ostream & operator << (std::ostream & s, UInt64 const & json);
 
-    }; // json::String
+    }; // json::UInt64
 
-    /** JSON Array. 
+    /** Double JSON value. 
+     
+        Contrary to JSON specification numbers are stored as either double, or boolean values. 
      */
-    class Array {
+    class Double : public detail::Scalar<double> {
     public:
-        Array() = default;
-        Array(Array const & from):
-            comment_{from.comment_} {
-            for (Value * v : from.elements_)
-                add(*v);
-        }
+        explicit Double(double value): Scalar{Kind::Double, value} {}
 
-        Array(Array &&) = default;
+        operator double () const { return value(); }
 
-        ~Array();
+        bool operator == (Double const & other) const { return value() == other.value(); }
+        bool operator != (Double const & other) const { return value() != other.value(); }
 
-        std::string const & comment() const { return comment_; }
-        void setComment(std::string_view comment) { comment_ = comment; }
+    private:
+        friend class Value;
 
-        Value const & operator [] (size_t i) const { return *elements_[i]; }
-        Value & operator [] (size_t i) { return *elements_[i]; }
+        friend std::ostream & operator << (std::ostream & s, Double const & json);
 
-        void add(Value const & value);
-        void add(Value && value);
+    }; // json::Double
 
-        bool operator == (Array const & other) const {
-            if (elements_.size() != other.elements_.size())
-                return false;
-            for (size_t i = 0, e = elements_.size(); i < e; ++i)
-                if (elements_[i] != other.elements_[i])
-                    return false;
-            return true;
+    /** String JSON value. 
+     
+        The string either owns its characters, or borrows them from a buffer that must outlive it, such as the input of parseInSitu(). Moving a borrowed string keeps the borrow, but copies always own their characters so that they can outlive the buffer. 
+
+        Owned strings of up to MaxInlineSize (14) characters, such as most keys, enumeration values, numeric identifiers and dates, are stored inline in the 15 bytes that follow the header, together with their null terminator, and never allocate. The last of these bytes holds the number of unused characters, so that it doubles as the terminator of a full string. Longer owned strings are allocated on the heap, and together with borrowed strings keep their size and the pointer to their characters in the same bytes, which limits the size of strings to 4GB. Owned characters are null terminated. 
+     */
+    class String {
+    public:
+        explicit String(std::string_view value):header_{Kind::String} { clear(); assign(value); }
+        explicit String(char const * value):String{std::string_view{value}} {}
+
+        String(String const & from):
+            header_{Kind::String} {
+            clear();
+            assign(from.view());
+            setComment(from.comment());
         }
 
-        bool operator != (Array const & other) const { 
-            if (elements_.size() != other.elements_.size())
-                return true;
-            for (size_t i = 0, e = elements_.size(); i < e; ++i)
-                if (elements_[i] != other.elements_[i])
-                    return true;
-            return false;
+        String(String && from) noexcept:
+            header_{std::move(from.header_)} {
+            steal(from);
         }
 
-    private:
+        ~String() {
+            release();
+        }
 
-        friend inline std::ostream & operator << (std::ostream & s, Array const & json) {
-            s << "[";
-            auto i = json.elements_.begin(), e = json.elements_.end();
-            while (i != e) {
-                s << **i;
-                if (++i != e)
-                    s << ", ";
+        String & operator = (String const & other) {
+            if (this != &other) {
+                assign(other.view());
+                setComment(other.comment());
             }
-            s << "]";
-            return s;
+            return *this;
         }
 
-        std::vector<Value*> elements_; // have to use ptrs (incomplete type)
-        std::string comment_;
+        String & operator = (String && other) noexcept {
+            if (this != &other) {
+                release();
+                header_ = other.header_;
+                steal(other);
+            }
+            return *this;
+        }
 
-    }; // json::Array
+        /** Creates a string that borrows the given characters instead of copying them. 
+         */
+        static String borrow(std::string_view value) {
+            String result{std::string_view{}};
+            result.store(SizeOffset, checkSize(value.size()));
+            result.store(PointerOffset, value.data());
+            result.header_.set(Borrowed, true);
+            return result;
+        }
 
-    /** JSON Struct.
-     */
-    class Struct {
-    public:
+        std::string const & comment() const { return header_.commented() ? annex()->comment : detail::noComment(); }
 
-        Struct() = default;
-        Struct(Struct const & from):
-            comment_{from.comment_} {
-            for (auto i : from.elements_) {
-                set(i.first, *i.second);
+        /** Sets the comment. 
+         
+            A string with a comment keeps the pointer to its characters in the annex with the comment, so short strings are no longer inline while they have a comment. 
+         */
+        void setComment(std::string_view comment) {
+            if (header_.commented()) {
+                if (! comment.empty()) {
+                    annex()->comment = comment;
+                    return;
+                }
+                detail::Annex<char const *> * annex = this->annex();
+                store(PointerOffset, annex->value);
+                header_.setCommented(false);
+                delete annex;
+                if (header_.has(Allocated) && size() <= MaxInlineSize) 
+                    assign(view());
+            } else if (! comment.empty()) {
+                std::unique_ptr<detail::Annex<char const *>> annex{new detail::Annex<char const *>{std::string{comment}, nullptr}};
+                if (isInline()) {
+                    uint32_t size = static_cast<uint32_t>(this->size());
+                    char * copy = new char[size + 1];
+                    std::memcpy(copy, bytes_, size + 1);
+                    annex->value = copy;
+                    store(SizeOffset, size);
+                    header_.set(Allocated, true);
+                } else {
+                    annex->value = pointer();
+                }
+                store(PointerOffset, annex.release());
+                header_.setCommented(true);
             }
         }
-        
-        Struct(Struct &&) = default;
 
-        ~Struct();
+        /** Returns true if the string references characters it does not own. 
+         */
+        bool borrowed() const { return header_.has(Borrowed); }
 
-        std::string const & comment() const { return comment_; }
-        void setComment(std::string_view comment) { comment_ = comment; }
+        std::string_view view() const { return std::string_view{chars(), size()}; }
 
-        Value const & operator [] (size_t i) const { return *(elements_[i].second); }
-        Value & operator [] (size_t i) { return *(elements_[i].second); }
+        size_t size() const { 
+            return isInline() ? MaxInlineSize - static_cast<uint8_t>(bytes_[MaxInlineSize]) : load<uint32_t>(SizeOffset); 
+        }
 
+        /** Returns the null terminated string. 
+         
+            Borrowed strings are not null terminated, so calling c_str() on them throws std::logic_error. Use view(), which works for all strings, when the string may be borrowed. 
+         */
+        char const * c_str() const { 
+            if (borrowed())
+                throw std::logic_error{"Borrowed strings are not null terminated, use view()"};
+            return chars(); 
+        }
 
-        Value const & operator [] (std::string const & i) const;
-        Value & operator [] (std::string const & i);
+        bool operator == (String const & other) const { return view() == other.view(); }
+        bool operator != (String const & other) const { return view() != other.view(); }
 
-        void set(std::string const & name, Value const & value);
-        void set(std::string const & name, Value && value);
+        /** Owned strings of up to this many characters are stored inline, i.e. all bytes after the header but the one for the null terminator. 
+         */
+        static constexpr size_t MaxInlineSize = 14;
 
-        bool operator == (Struct const & other) const {
-            if (elements_.size() != other.elements_.size())
-                return false;
-            for (size_t i = 0, e = elements_.size(); i < e; ++i)
-                if (elements_[i] != other.elements_[i])
-                    return false;
-            return true;
-        }
+    private:
+        friend class Value;
 
-        bool operator != (Struct const & other) const { 
-            if (elements_.size() != other.elements_.size())
-                return true;
-            for (size_t i = 0, e = elements_.size(); i < e; ++i)
-                if (elements_[i] != other.elements_[i])
-                    return true;
-            return false;
-        }
+        friend std::ostream & operator << (std::ostream & s, String const & json);
 
-    private:
+        static constexpr uint8_t Borrowed = 0x20;
+        static constexpr uint8_t Allocated = 0x40;
 
-        friend inline std::ostream & operator << (std::ostream & s, Struct const & json) {
-            s << "{";
-            auto i = json.elements_.begin(), e = json.elements_.end();
-            while (i != e) {
-                s << '"' << i->first << "\" : " << *(i->second);
-                if (++i != e)
-                    s << ", ";
-            }
-            s << "}";
-            return s;
-        }
+        /** Offsets of the size and of the pointer in the bytes of strings that are not inline, chosen so that both are aligned within the value. 
+         */
+        static constexpr size_t SizeOffset = 3;
+        static constexpr size_t PointerOffset = 7;
 
-        std::vector<std::pair<std::string, Value*>> elements_; // have to use ptrs (incomplete type)
-        std::unordered_map<std::string, size_t> elementsByName_; 
-        std::string comment_;
-    }; // json::Struct
+        bool isInline() const { return ! header_.has(Borrowed | Allocated); }
 
-    /** A Generic JSON value class. 
-     
-        Provides a tagged union of all JSON values that can be easily manipulated providing some basic conversions as well. 
+        char const * chars() const { return isInline() ? bytes_ : pointer(); }
+
+        /** Returns the pointer to the characters of a string that is not inline. 
+         */
+        char const * pointer() const { return header_.commented() ? annex()->value : load<char const *>(PointerOffset); }
+
+        void setPointer(char const * chars) { 
+            if (header_.commented())
+                annex()->value = chars;
+            else
+                store(PointerOffset, chars);
+        }
+
+        detail::Annex<char const *> * annex() const { return load<detail::Annex<char const *> *>(PointerOffset); }
+
+        template<typename T>
+        T load(size_t offset) const {
+            T result;
+            std::memcpy(&result, bytes_ + offset, sizeof(T));
+            return result;
+        }
+
+        template<typename T>
+        void store(size_t offset, T value) {
+            static_assert(PointerOffset + sizeof(char const *) <= sizeof(bytes_));
+            std::memcpy(bytes_ + offset, &value, sizeof(T));
+        }
+
+        static uint32_t checkSize(size_t size) {
+            if (size > std::numeric_limits<uint32_t>::max())
+                throw std::length_error{"String too long"};
+            return static_cast<uint32_t>(size);
+        }
+
+        /** Makes the string an empty inline string, regardless of its previous contents. 
+         */
+        void clear() {
+            std::memset(bytes_, 0, sizeof(bytes_));
+            bytes_[MaxInlineSize] = static_cast<char>(MaxInlineSize);
+        }
+
+        /** Replaces the characters with an owned copy of the given ones, which may be the string's own characters. 
+         */
+        void assign(std::string_view value) {
+            uint32_t size = checkSize(value.size());
+            if (size <= MaxInlineSize && ! header_.commented()) {
+                // the value may be the string's own characters, which detach would free
+                char copy[sizeof(bytes_)] = {};
+                if (size > 0)
+                    std::memcpy(copy, value.data(), size);
+                copy[MaxInlineSize] = static_cast<char>(MaxInlineSize - size);
+                detach();
+                std::memcpy(bytes_, copy, sizeof(bytes_));
+                header_.set(Borrowed | Allocated, false);
+            } else {
+                char * copy = new char[size + 1];
+                std::memcpy(copy, value.data(), size);
+                copy[size] = '\0';
+                detach();
+                setPointer(copy);
+                store(SizeOffset, size);
+                header_.set(Borrowed, false);
+                header_.set(Allocated, true);
+            }
+        }
+
+        /** Takes the characters and the comment of the other string, which is left empty. The header must have already been copied. 
+         */
+        void steal(String & other) {
+            std::memcpy(bytes_, other.bytes_, sizeof(bytes_));
+            other.header_ = detail::Header{Kind::String};
+            other.clear();
+        }
+
+        /** Frees the owned characters, but not the comment. 
+         */
+        void detach() {
+            if (header_.has(Allocated))
+                delete [] pointer();
+        }
+
+        void release() {
+            detach();
+            if (header_.commented())
+                delete annex();
+        }
+
+        detail::Header header_;
+        char bytes_[MaxInlineSize + 1];
+
+    }; // json::String
+
+    /** JSON Array. 
+     
+        The elements are stored contiguously in a vector allocated from a memory resource, which is the default heap unless given otherwise. The array itself is only a pointer to the vector, which is not allocated for empty arrays from the default resource. Like with std::vector, adding elements may reallocate the vector, which invalidates all references, pointers and iterators to the elements obtained before. Elements of the array itself can still be passed to add(), which copies, or moves them before the old vector is released. 
+
+        Copying an array from the default resource takes constant time, as the copy shares the vector with the original and the vector is copied only when either of them is about to be modified (copy on write). This includes calling any non-const accessor, so read-only access to shared arrays should go through const references. Since the references and pointers returned by the non-const accessors may be used to modify the array at any later time, an array that has handed them out is no longer shared by its copies, which copy its elements instead. Arrays from other resources, such as a document's arena, and arrays parsed with borrowed strings or interned keys are copied into the default resource so that the copy can outlive the original's resource or input. Values moved into the array are kept as they are, so moving in a value that cannot be shared, such as a borrowed string, or an array or struct that would itself be copied, makes the array copied as well. 
+
+        Since Value is incomplete at this point, the methods that access the elements are defined after it. 
      */
-    class Value {
+    class Array {
     public:
-        enum class Kind {
-            Undefined, 
-            Null, 
-            Bool, 
-            Int,
-            Double,
-            String,
-            Array,
-            Struct
-        }; // json::Value::Kind
+        Array(): header_{Kind::Array}, body_{nullptr} {}
 
-        Value(): kind_{Kind::Undefined}, valueUndefined_{} {}
+        explicit Array(std::pmr::memory_resource * resource);
 
-        Value(Undefined value): kind_{Kind::Undefined}, valueUndefined_{} { UNUSED(value); }
-        Value(Null value): kind_{Kind::Null}, valueNull_{} { UNUSED(value); }
+        Array(Array const & from);
 
-        Value(bool value): kind_{Kind::Bool}, valueBool_{value} {}
-        Value(Bool value): kind_{Kind::Bool}, valueBool_{value} {}
+        Array(Array && from) noexcept:
+            header_{std::move(from.header_)},
+            body_{from.body_} {
+            from.body_ = nullptr;
+        }
 
-        Value(int value): kind_{Kind::Int}, valueInt_{value} {}
-        Value(Int value): kind_{Kind::Int}, valueInt_{value} {}
+        ~Array();
 
-        Value(double value): kind_{Kind::Double}, valueDouble_{value} {}
-        Value(Double value): kind_{Kind::Double}, valueDouble_{value} {}
+        /** The comment is kept in the body with the elements, so that arrays without comments do not pay for it. 
+         */
+        std::string const & comment() const;
+        void setComment(std::string_view comment);
 
-        Value(std::string_view value): kind_{Kind::String}, valueString_{value} {}
-        Value(std::string && value): kind_{Kind::String}, valueString_{std::move(value)} {}
-        Value(char const * value): kind_{Kind::String}, valueString_{value} {}
-        Value(String const & value): kind_{Kind::String}, valueString_{value} {}
-        Value(String && value): kind_{Kind::String}, valueString_{std::move(value)} {}
+        size_t size() const;
 
-        Value(Array const & value): kind_{Kind::Array}, valueArray_{value} {}
-        Value(Array && value): kind_{Kind::Array}, valueArray_{std::move(value)} {}
+        Value const & operator [] (size_t i) const;
+        Value & operator [] (size_t i);
 
-        Value(Struct const & value): kind_{Kind::Struct}, valueStruct_{value} {}
-        Value(Struct && value): kind_{Kind::Struct}, valueStruct_{std::move(value)} {}
+        Value const * begin() const;
+        Value const * end() const;
+        Value * begin();
+        Value * end();
 
-        Value(Value const & from):
-            kind_{from.kind_},
-            valueUndefined_{} {
-            switch (kind_) {
-                case Kind::Undefined:
-                    break;
-                case Kind::Null:
-                    new (&valueNull_) Null{};
-                    break;
-                case Kind::Bool:
-                    new (&valueBool_) Bool{from.valueBool_};
-                    break;
-                case Kind::Int:
-                    new (&valueInt_) Int{from.valueInt_};
-                    break;
-                case Kind::Double:
-                    new (&valueDouble_) Double{from.valueDouble_};
-                    break;
-                case Kind::String:
-                    new (&valueString_) String{from.valueString_};
-                    break;
-                case Kind::Array:
-                    new (&valueArray_) Array{from.valueArray_};
-                    break;
-                case Kind::Struct:
-                    new (&valueStruct_) Struct{from.valueStruct_};
-            }
+        void add(Value const & value);
+        void add(Value && value);
+
+        bool operator == (Array const & other) const;
+        bool operator != (Array const & other) const { return ! (*this == other); }
+
+    private:
+        friend class Value;
+
+        struct Body;
+
+        friend std::ostream & operator << (std::ostream & s, Array const & json);
+
+        /** Returns the body for modification, creating it in the default resource if the array does not have one yet, or copying it if it is shared with other arrays. 
+         */
+        Body & body();
+
+        /** Drops the reference to the body, deleting it if it was the last one. 
+         */
+        static void release(Body * body);
+
+        /** Returns the body for modification through references or pointers that are handed out to the caller. Since they can be used to modify the body after the array has been copied, the body can no longer be shared.  
+         */
+        Body & exposedBody();
+
+        /** Prevents copies of the array from sharing its body, because it holds values that must not outlive the original, such as strings borrowed from the parser's input, or field names interned in a key table. 
+         */
+        void disableSharing();
+
+        detail::Header header_;
+        Body * body_; 
+
+    }; // json::Array
+
+    /** Struct field name interned in a KeyTable. 
+     */
+    class Key {
+    public:
+        std::string_view name() const { return name_; }
+
+    private:
+        friend class KeyTable;
+
+        explicit Key(std::string_view name):
+            name_{name} {
         }
 
-        Value(Value && from):
-            kind_{from.kind_},
-            valueUndefined_{} {
-            switch (kind_) {
-                case Kind::Undefined:
-                    break;
-                case Kind::Null:
-                    new (&valueNull_) Null{};
-                    break;
-                case Kind::Bool:
-                    new (&valueBool_) Bool{std::move(from.valueBool_)};
-                    break;
-                case Kind::Int:
-                    new (&valueInt_) Int{std::move(from.valueInt_)};
-                    break;
-                case Kind::Double:
-                    new (&valueDouble_) Double{std::move(from.valueDouble_)};
-                    break;
-                case Kind::String:
-                    new (&valueString_) String{std::move(from.valueString_)};
-                    break;
-                case Kind::Array:
-                    new (&valueArray_) Array{std::move(from.valueArray_)};
-                    break;
-                case Kind::Struct:
-                    new (&valueStruct_) Struct{std::move(from.valueStruct_)};
+        std::string_view name_;
+    }; // json::Key
+
+    /** Table of interned struct field names. 
+     
+        When parsing many values with the same field names, such as NDJSON records, the parser can intern the names in a key table. The parsed structs then refer to the names in the table instead of copying them, and compare them by pointer. The table can be shared by parsers in multiple threads and must outlive all values parsed with it, except their copies, which own their field names. 
+     */
+    class KeyTable {
+    public:
+        KeyTable() = default;
+        KeyTable(KeyTable const &) = delete;
+        KeyTable & operator = (KeyTable const &) = delete;
+
+        /** Returns the interned key with given name, adding it to the table if necessary. 
+         */
+        Key intern(std::string_view name) {
+            {
+                std::shared_lock<std::shared_mutex> g{m_};
+                auto i = index_.find(name);
+                if (i != index_.end())
+                    return Key{*i};
             }
+            std::unique_lock<std::shared_mutex> g{m_};
+            auto i = index_.find(name);
+            if (i != index_.end())
+                return Key{*i};
+            names_.emplace_back(name);
+            std::string_view result{names_.back()};
+            index_.insert(result);
+            return Key{result};
+        }
+
+        size_t size() const {
+            std::shared_lock<std::shared_mutex> g{m_};
+            return index_.size();
+        }
+
+    private:
+        mutable std::shared_mutex m_;
+        // deque so that the names never move
+        std::deque<std::string> names_;
+        std::unordered_set<std::string_view> index_;
+    }; // json::KeyTable
+
+    /** JSON Struct.
+     
+        Each field stores its name and value together, so that the name is kept only once. The fields are kept in segments that never move, so that adding a field does not invalidate references to the other fields, e.g. `s["b"] = s["c"]` is safe. The name's characters are either owned by the struct, or interned in a KeyTable. Small structs, which are the majority, are searched linearly comparing lengths first. Once a struct has more than SmallSize fields, lookup by name uses an open addressing hash table of field indices, which only refers to the fields. Like arrays, the fields and the index are allocated from a memory resource and the struct itself is only a pointer to them, which copies from the default resource share until modified. As with arrays, structs that have handed out non-const references to their fields, or had values that cannot be shared moved into them, are not shared by their copies. 
+
+        Since Value is incomplete at this point, the field type and the methods that access the fields are defined after it. 
+     */
+    class Struct {
+    public:
+
+        Struct(): header_{Kind::Struct}, body_{nullptr} {}
+
+        explicit Struct(std::pmr::memory_resource * resource);
+
+        Struct(Struct const & from);
+        
+        Struct(Struct && from) noexcept:
+            header_{std::move(from.header_)},
+            body_{from.body_} {
+            from.body_ = nullptr;
+        }
+
+        ~Struct();
+
+        /** The comment is kept in the body with the fields, so that structs without comments do not pay for it. 
+         */
+        std::string const & comment() const;
+        void setComment(std::string_view comment);
+
+        size_t size() const;
+
+        /** Returns the name of the i-th field. 
+         */
+        std::string_view key(size_t i) const;
+
+        Value const & operator [] (size_t i) const;
+        Value & operator [] (size_t i);
+
+        /** Returns the field of given name, or undefined if there is no such field. 
+         */
+        Value const & operator [] (std::string_view name) const;
+
+        /** Returns the field of given name, adding it as undefined if it does not exist yet. 
+         */
+        Value & operator [] (std::string_view name);
+
+        /** Returns the field of given interned name, adding it as undefined if it does not exist yet. 
+         
+            The field refers to the name in the key table instead of copying it. 
+         */
+        Value & operator [] (Key key);
+
+        void set(std::string_view name, Value const & value);
+        void set(std::string_view name, Value && value);
+
+        bool operator == (Struct const & other) const;
+        bool operator != (Struct const & other) const { return ! (*this == other); }
+
+        /** Structs with up to this many fields have no hash index. 
+         */
+        static constexpr size_t SmallSize = 8;
+
+    private:
+        friend class Value;
+
+        struct Field;
+        struct Body;
+
+        friend std::ostream & operator << (std::ostream & s, Struct const & json);
+
+        /** Returns the index of the field with given name, or size() if there is none. 
+         
+            Names interned in the same key table match by pointer without comparing their characters. 
+         */
+        size_t find(std::string_view name) const;
+
+        /** Adds the i-th field to the index, building or growing the index if necessary. 
+         */
+        void addToIndex(size_t i);
+
+        /** Returns the body for modification, creating it in the default resource if the struct does not have one yet, or copying it if it is shared with other structs. 
+         */
+        Body & body();
+
+        /** Drops the reference to the body, deleting it if it was the last one. 
+         */
+        static void release(Body * body);
+
+        /** Returns the body for modification through references or pointers that are handed out to the caller. Since they can be used to modify the body after the struct has been copied, the body can no longer be shared.  
+         */
+        Body & exposedBody();
+
+        /** Returns the field of given name, adding it as undefined if it does not exist yet, without exposing the body. 
+         */
+        Value & field(std::string_view name);
+        Value & field(Key key);
+
+        /** Prevents copies of the struct from sharing its body, because it holds values that must not outlive the original, such as strings borrowed from the parser's input, or field names interned in a key table. 
+         */
+        void disableSharing();
+
+        /** Returns a copy of the body in the default resource that owns all its field names. 
+         */
+        static Body * copy(Body const & from);
+
+        detail::Header header_;
+        Body * body_;
+    }; // json::Struct
+
+    /** A Generic JSON value class. 
+     
+        Provides a tagged union of all JSON values that can be easily manipulated providing some basic conversions as well. Since all value classes start with the same header, which also holds the kind, the value is only as large as the largest value class, i.e. 16 bytes. 
+     */
+    class Value {
+    public:
+        using Kind = json::Kind;
+
+        Value(): valueUndefined_{} {}
+
+        Value(Undefined value): valueUndefined_{std::move(value)} {}
+        Value(Null value): valueNull_{std::move(value)} {}
+
+        Value(bool value): valueBool_{value} {}
+        Value(Bool value): valueBool_{std::move(value)} {}
+
+        Value(int value): valueInt_{value} {}
+        Value(Int value): valueInt_{std::move(value)} {}
+
+        Value(int64_t value): valueInt64_{value} {}
+        Value(Int64 value): valueInt64_{std::move(value)} {}
+
+        Value(uint64_t value): valueUInt64_{value} {}
+        Value(UInt64 value): valueUInt64_{std::move(value)} {}
+
+        Value(double value): valueDouble_{value} {}
+        Value(Double value): valueDouble_{std::move(value)} {}
+
+        Value(std::string_view value): valueString_{value} {}
+        Value(std::string const & value): valueString_{std::string_view{value}} {}
+        Value(char const * value): valueString_{value} {}
+        Value(String const & value): valueString_{value} {}
+        Value(String && value): valueString_{std::move(value)} {}
+
+        Value(Array const & value): valueArray_{value} {}
+        Value(Array && value): valueArray_{std::move(value)} {}
+
+        Value(Struct const & value): valueStruct_{value} {}
+        Value(Struct && value): valueStruct_{std::move(value)} {}
+
+        Value(Value const & from) {
+            copyFrom(from);
+        }
+
+        Value(Value && from) noexcept {
+            moveFrom(std::move(from));
         }
 
         ~Value() {
             detach();
         }
 
+        /** Returns the kind of the value. 
+         
+            All value classes start with the header, so it can be read from any of them. 
+         */
+        Kind kind() const { return valueUndefined_.header_.kind(); }
+
         std::string const & comment() const {
-            switch (kind_) {
+            switch (kind()) {
                 case Kind::Undefined:
                     return valueUndefined_.comment();
                 case Kind::Null:
@@ -431,6 +1245,10 @@ namespace json {
                     return valueBool_.comment();
                 case Kind::Int:
                     return valueInt_.comment();
+                case Kind::Int64:
+                    return valueInt64_.comment();
+                case Kind::UInt64:
+                    return valueUInt64_.comment();
                 case Kind::Double:
                     return valueDouble_.comment();
                 case Kind::String:
@@ -441,100 +1259,72 @@ namespace json {
                     return valueStruct_.comment();
                 default:
                     UNREACHABLE;
+                    // UNREACHABLE is empty in release builds
+                    return detail::noComment();
             }
         }
 
         void setComment(std::string_view comment) {
-            switch (kind_) {
-                case Kind::Undefined:
-                    return valueUndefined_.setComment(comment);
-                case Kind::Null:
-                    return valueNull_.setComment(comment);
-                case Kind::Bool:
-                    return valueBool_.setComment(comment);
-                case Kind::Int:
-                    return valueInt_.setComment(comment);
-                case Kind::Double:
-                    return valueDouble_.setComment(comment);
-                case Kind::String:
-                    return valueString_.setComment(comment);
-                case Kind::Array:
-                    return valueArray_.setComment(comment);
-                case Kind::Struct:
-                    return valueStruct_.setComment(comment);
-            }
-        }
-
-        template<typename T> T const & as() const;
-        template<typename T> T & as();
-
-        Value & operator = (Value const & other) {
-            detach();
-            kind_ = other.kind_;
-            switch (kind_) {
+            switch (kind()) {
                 case Kind::Undefined:
-                    new (&valueUndefined_) Undefined{};
+                    valueUndefined_.setComment(comment);
                     break;
                 case Kind::Null:
-                    new (&valueNull_) Null{};
+                    valueNull_.setComment(comment);
                     break;
                 case Kind::Bool:
-                    new (&valueBool_) Bool(other.valueBool_);
+                    valueBool_.setComment(comment);
                     break;
                 case Kind::Int:
-                    new (&valueInt_) Int{other.valueInt_};
+                    valueInt_.setComment(comment);
+                    break;
+                case Kind::Int64:
+                    valueInt64_.setComment(comment);
+                    break;
+                case Kind::UInt64:
+                    valueUInt64_.setComment(comment);
                     break;
                 case Kind::Double:
-                    new (&valueDouble_) Double(other.valueDouble_);
+                    valueDouble_.setComment(comment);
                     break;
                 case Kind::String:
-                    new (&valueString_) String(other.valueString_);
+                    valueString_.setComment(comment);
                     break;
                 case Kind::Array:
-                    new (&valueArray_) Array(other.valueArray_);
+                    valueArray_.setComment(comment);
                     break;
                 case Kind::Struct:
-                    new (&valueStruct_) Struct{other.valueStruct_};
+                    valueStruct_.setComment(comment);
                     break;
             }
+        }
+
+        template<typename T> T const & as() const;
+        template<typename T> T & as();
+
+        Value & operator = (Value const & other) {
+            if (this != &other) {
+                // other may be part of this value
+                Value copy{other};
+                detach();
+                moveFrom(std::move(copy));
+            }
             return *this;
         }
 
         Value & operator = (Value && other) {
-            detach();
-            kind_ = other.kind_;
-            switch (kind_) {
-                case Kind::Undefined:
-                    new (&valueUndefined_) Undefined{};
-                    break;
-                case Kind::Null:
-                    new (&valueNull_) Null{};
-                    break;
-                case Kind::Bool:
-                    new (&valueBool_) Bool{std::move(other.valueBool_)};
-                    break;
-                case Kind::Int:
-                    new (&valueInt_) Int{std::move(other.valueInt_)};
-                    break;
-                case Kind::Double:
-                    new (&valueDouble_) Double{std::move(other.valueDouble_)};
-                    break;
-                case Kind::String:
-                    new (&valueString_) String{std::move(other.valueString_)};
-                    break;
-                case Kind::Array:
-                    new (&valueArray_) Array{std::move(other.valueArray_)};
-                    break;
-                case Kind::Struct:
-                    new (&valueStruct_) Struct{std::move(other.valueStruct_)};
+            if (this != &other) {
+                Value moved{std::move(other)};
+                detach();
+                moveFrom(std::move(moved));
             }
             return *this;
         }
 
         bool operator == (Value const & other) const {
-            if (kind_ != other.kind_)
+            if (kind() != other.kind())
                 return false;
-            switch (kind_) {
+            switch (kind()) {
                 case Kind::Undefined:
                 case Kind::Null:
                     return true;
@@ -542,6 +1332,10 @@ namespace json {
                     return valueBool_ == other.valueBool_;
                 case Kind::Int:
                     return valueInt_ == other.valueInt_;
+                case Kind::Int64:
+                    return valueInt64_ == other.valueInt64_;
+                case Kind::UInt64:
+                    return valueUInt64_ == other.valueUInt64_;
                 case Kind::Double:
                     return valueDouble_ == other.valueDouble_;
                 case Kind::String:
@@ -552,12 +1346,16 @@ namespace json {
                     return valueStruct_ == other.valueStruct_;
                 default:
                     UNREACHABLE;
+                    // UNREACHABLE is empty in release builds
+                    return false;
             }
         }
 
         friend bool operator == (Undefined const & a, Value const & b) { return b == a; }
         friend bool operator == (Null const & a, Value const & b) { return b == a; }
         friend bool operator == (Int const & a, Value const & b) { return b == a; }
+        friend bool operator == (Int64 const & a, Value const & b) { return b == a; }
+        friend bool operator == (UInt64 const & a, Value const & b) { return b == a; }
         friend bool operator == (Double const & a, Value const & b) { return b == a; }
         friend bool operator == (String const & a, Value const & b) { return b == a; }
         friend bool operator == (Array const & a, Value const & b) { return b == a; }
@@ -565,38 +1363,111 @@ namespace json {
 
     private:
 
-        friend inline std::ostream & operator << (std::ostream & s, Value const & json) {
-            switch (json.kind_) {
-                case Kind::Undefined:
-                    s << json.valueUndefined_;
+        friend class Array;
+        friend class Struct;
+        friend std::ostream & operator << (std::ostream & s, Value const & json);
+
+        /** Returns true if arrays and structs holding the value can be shared by their copies, i.e. the value does not borrow its characters and its body, if any, can be shared as well. 
+         */
+        bool shareable() const;
+
+        /** Constructs the value as a copy of the given one. The value must not be constructed yet.
+         */
+        void copyFrom(Value const & from) {
+            switch (from.kind()) {
+                case Kind::Undefined:
+                    new (&valueUndefined_) Undefined{from.valueUndefined_};
                     break;
                 case Kind::Null:
-                    s << json.valueNull_;
+                    new (&valueNull_) Null{from.valueNull_};
                     break;
                 case Kind::Bool:
-                    s << json.valueBool_;
+                    new (&valueBool_) Bool{from.valueBool_};
                     break;
                 case Kind::Int:
-                    s << json.valueInt_;
+                    new (&valueInt_) Int{from.valueInt_};
+                    break;
+                case Kind::Int64:
+                    new (&valueInt64_) Int64{from.valueInt64_};
+                    break;
+                case Kind::UInt64:
+                    new (&valueUInt64_) UInt64{from.valueUInt64_};
                     break;
                 case Kind::Double:
-                    s << json.valueDouble_;
+                    new (&valueDouble_) Double{from.valueDouble_};
                     break;
                 case Kind::String:
-                    s << json.valueString_;
+                    new (&valueString_) String{from.valueString_};
                     break;
                 case Kind::Array:
-                    s << json.valueArray_;
+                    new (&valueArray_) Array{from.valueArray_};
                     break;
                 case Kind::Struct:
-                    s << json.valueStruct_;
+                    new (&valueStruct_) Struct{from.valueStruct_};
+                    break;
+            }
+        }
+
+        /** Constructs the value by moving from the given one. The value must not be constructed yet.
+         */
+        void moveFrom(Value && from) noexcept {
+            switch (from.kind()) {
+                case Kind::Undefined:
+                    new (&valueUndefined_) Undefined{std::move(from.valueUndefined_)};
+                    break;
+                case Kind::Null:
+                    new (&valueNull_) Null{std::move(from.valueNull_)};
+                    break;
+                case Kind::Bool:
+                    new (&valueBool_) Bool{std::move(from.valueBool_)};
+                    break;
+                case Kind::Int:
+                    new (&valueInt_) Int{std::move(from.valueInt_)};
+                    break;
+                case Kind::Int64:
+                    new (&valueInt64_) Int64{std::move(from.valueInt64_)};
+                    break;
+                case Kind::UInt64:
+                    new (&valueUInt64_) UInt64{std::move(from.valueUInt64_)};
+                    break;
+                case Kind::Double:
+                    new (&valueDouble_) Double{std::move(from.valueDouble_)};
+                    break;
+                case Kind::String:
+                    new (&valueString_) String{std::move(from.valueString_)};
+                    break;
+                case Kind::Array:
+                    new (&valueArray_) Array{std::move(from.valueArray_)};
+                    break;
+                case Kind::Struct:
+                    new (&valueStruct_) Struct{std::move(from.valueStruct_)};
                     break;
             }
-            return s;
         }
 
         void detach() {
-            switch (kind_) {
+            switch (kind()) {
+                case Kind::Undefined:
+                    valueUndefined_.~Undefined();
+                    break;
+                case Kind::Null:
+                    valueNull_.~Null();
+                    break;
+                case Kind::Bool:
+                    valueBool_.~Bool();
+                    break;
+                case Kind::Int:
+                    valueInt_.~Int();
+                    break;
+                case Kind::Int64:
+                    valueInt64_.~Int64();
+                    break;
+                case Kind::UInt64:
+                    valueUInt64_.~UInt64();
+                    break;
+                case Kind::Double:
+                    valueDouble_.~Double();
+                    break;
                 case Kind::String:
                     valueString_.~String();
                     break;
@@ -606,17 +1477,16 @@ namespace json {
                 case Kind::Struct:
                     valueStruct_.~Struct();
                     break;
-                default:
-                    break; // trivial destructors
             }
         }
 
-        Kind kind_;
         union {
             Undefined valueUndefined_;
             Null valueNull_;
             Bool valueBool_;
             Int valueInt_;
+            Int64 valueInt64_;
+            UInt64 valueUInt64_;
             Double valueDouble_;
             String valueString_;
             Array valueArray_;
@@ -624,97 +1494,614 @@ namespace json {
         };
 
         friend Value parse(std::istream &);
+        friend Value parse(std::string_view);
+        friend Value parse(std::string_view, KeyTable &);
+        friend Value parseInSitu(std::string_view);
+        template<typename HANDLER> friend void parse(std::string_view, HANDLER &);
+        template<typename HANDLER> friend void parse(std::istream &, HANDLER &);
+        friend class Document;
+        friend class Reader;
+        friend class Lazy;
+        friend class ValueBuilder;
+        template<typename HANDLER> friend class ChunkedParser;
 
         class Parser;
 
     }; // json::Value
 
+    static_assert(sizeof(Value) == 16, "Value must be 16 bytes");
+
     /** The undefined singleton that is returned by any unsupported operation. 
      */
     inline const Value undefined = Value{Undefined{}};
 
     template<> 
     inline Bool const & Value::as() const {
-        if (kind_ != Kind::Bool)
+        if (kind() != Kind::Bool)
             throw "Expected bool but found";
         return valueBool_;
     }
 
     template<> 
     inline Bool & Value::as() {
-        if (kind_ != Kind::Bool)
+        if (kind() != Kind::Bool)
             throw "Expected bool but found";
         return valueBool_;
     }
 
     template<> 
     inline Int const & Value::as() const {
-        if (kind_ != Kind::Int)
+        if (kind() != Kind::Int)
             throw "Expected bool but found";
         return valueInt_;
     }
 
     template<> 
     inline Int & Value::as() {
-        if (kind_ != Kind::Int)
+        if (kind() != Kind::Int)
             throw "Expected bool but found";
         return valueInt_;
     }
 
+    template<> 
+    inline String const & Value::as() const {
+        if (kind() != Kind::String)
+            throw "Expected string but found";
+        return valueString_;
+    }
+
+    template<> 
+    inline String & Value::as() {
+        if (kind() != Kind::String)
+            throw "Expected string but found";
+        return valueString_;
+    }
+
+    template<> 
+    inline Int64 const & Value::as() const {
+        if (kind() != Kind::Int64)
+            throw "Expected int64 but found";
+        return valueInt64_;
+    }
+
+    template<> 
+    inline Int64 & Value::as() {
+        if (kind() != Kind::Int64)
+            throw "Expected int64 but found";
+        return valueInt64_;
+    }
+
+    template<> 
+    inline UInt64 const & Value::as() const {
+        if (kind() != Kind::UInt64)
+            throw "Expected uint64 but found";
+        return valueUInt64_;
+    }
+
+    template<> 
+    inline UInt64 & Value::as() {
+        if (kind() != Kind::UInt64)
+            throw "Expected uint64 but found";
+        return valueUInt64_;
+    }
+
+    template<> 
+    inline Double const & Value::as() const {
+        if (kind() != Kind::Double)
+            throw "Expected double but found";
+        return valueDouble_;
+    }
+
+    template<> 
+    inline Double & Value::as() {
+        if (kind() != Kind::Double)
+            throw "Expected double but found";
+        return valueDouble_;
+    }
+
+    template<> 
+    inline Array const & Value::as() const {
+        if (kind() != Kind::Array)
+            throw "Expected array but found";
+        return valueArray_;
+    }
+
+    template<> 
+    inline Array & Value::as() {
+        if (kind() != Kind::Array)
+            throw "Expected array but found";
+        return valueArray_;
+    }
+
+    template<> 
+    inline Struct const & Value::as() const {
+        if (kind() != Kind::Struct)
+            throw "Expected struct but found";
+        return valueStruct_;
+    }
+
+    template<> 
+    inline Struct & Value::as() {
+        if (kind() != Kind::Struct)
+            throw "Expected struct but found";
+        return valueStruct_;
+    }
+
+    namespace detail {
+
+        /** Creates an object in the given memory resource. 
+         */
+        template<typename T, typename... ARGS>
+        inline T * create(std::pmr::memory_resource * resource, ARGS &&... args) {
+            void * p = resource->allocate(sizeof(T), alignof(T));
+            try {
+                return new (p) T{std::forward<ARGS>(args)...};
+            } catch (...) {
+                resource->deallocate(p, sizeof(T), alignof(T));
+                throw;
+            }
+        }
+
+        /** Destroys an object created in the given memory resource. 
+         */
+        template<typename T>
+        inline void destroy(std::pmr::memory_resource * resource, T * object) {
+            object->~T();
+            resource->deallocate(object, sizeof(T), alignof(T));
+        }
+
+        /** A vector whose elements never move once added. 
+         
+            The elements are stored in segments allocated from a memory resource, each twice as large as the previous one, so that adding elements does not invalidate references to the existing ones while indexing stays constant time. 
+         */
+        template<typename T, size_t FIRST = 4>
+        class StableVector {
+        public:
+            explicit StableVector(std::pmr::memory_resource * resource): segments_(resource) {}
+
+            StableVector(StableVector const &) = delete;
+            StableVector & operator = (StableVector const &) = delete;
+
+            ~StableVector() {
+                for (size_t i = size_; i > 0; --i)
+                    (*this)[i - 1].~T();
+                for (size_t s = 0, e = segments_.size(); s < e; ++s)
+                    resource()->deallocate(segments_[s], segmentSize(s) * sizeof(T), alignof(T));
+            }
+
+            size_t size() const { return size_; }
+
+            std::pmr::memory_resource * resource() const { return segments_.get_allocator().resource(); }
+
+            T const & operator [] (size_t i) const {
+                size_t s = segment(i);
+                return segments_[s][i - segmentStart(s)];
+            }
+
+            T & operator [] (size_t i) {
+                size_t s = segment(i);
+                return segments_[s][i - segmentStart(s)];
+            }
+
+            T & push_back(T && value) {
+                size_t s = segment(size_);
+                if (s == segments_.size()) {
+                    // reserve first so that the segment is not leaked if the push fails
+                    segments_.reserve(s + 1);
+                    segments_.push_back(static_cast<T *>(resource()->allocate(segmentSize(s) * sizeof(T), alignof(T))));
+                }
+                T * result = new (segments_[s] + (size_ - segmentStart(s))) T{std::move(value)};
+                ++size_;
+                return *result;
+            }
+
+        private:
+            static size_t segment(size_t i) { return highestBit(i / FIRST + 1); }
+            static size_t segmentStart(size_t s) { return FIRST * ((size_t{1} << s) - 1); }
+            static size_t segmentSize(size_t s) { return FIRST << s; }
+
+            std::pmr::vector<T *> segments_;
+            size_t size_ = 0;
+        }; // json::detail::StableVector
+
+    } // namespace json::detail
+
+    struct Array::Body {
+        explicit Body(std::pmr::memory_resource * resource, bool shareable = false):
+            shareable{shareable},
+            elements(resource) {
+        }
+
+        /** Creates a copy of the given body in the default resource. 
+         */
+        Body(Body const & from, std::pmr::memory_resource * resource):
+            shareable{true},
+            elements(from.elements.begin(), from.elements.end(), resource),
+            comment{from.comment == nullptr ? nullptr : new std::string{*from.comment}} {
+        }
+
+        // number of arrays sharing the body
+        std::atomic<uint32_t> refs{1};
+        // only bodies in the default resource that have not handed out references to their elements can be shared, others may not outlive their resource, or may be modified through the references
+        bool shareable;
+        std::pmr::vector<Value> elements;
+        std::unique_ptr<std::string> comment;
+    }; // json::Array::Body
+
+    inline Array::Array(std::pmr::memory_resource * resource):
+        header_{Kind::Array},
+        body_{resource == std::pmr::get_default_resource() ? nullptr : detail::create<Body>(resource, resource)} {
+    }
+
+    inline Array::Array(Array const & from):
+        header_{from.header_},
+        body_{nullptr} {
+        if (from.size() == 0 && from.comment().empty())
+            return;
+        if (from.body_->shareable) {
+            from.body_->refs.fetch_add(1, std::memory_order_relaxed);
+            body_ = from.body_;
+        } else {
+            body_ = detail::create<Body>(std::pmr::get_default_resource(), *from.body_, std::pmr::get_default_resource());
+        }
+    }
+
     inline Array::~Array() {
-        for (auto e : elements_) 
-            delete e;
+        release(body_);
+    }
+
+    inline Array::Body & Array::body() {
+        if (body_ == nullptr) {
+            body_ = detail::create<Body>(std::pmr::get_default_resource(), std::pmr::get_default_resource(), true);
+        } else if (body_->refs.load(std::memory_order_acquire) != 1) {
+            Body * copy = detail::create<Body>(std::pmr::get_default_resource(), *body_, std::pmr::get_default_resource());
+            release(body_);
+            body_ = copy;
+        }
+        return *body_;
+    }
+
+    inline void Array::release(Body * body) {
+        if (body != nullptr && body->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            detail::destroy(body->elements.get_allocator().resource(), body);
+    }
+
+    inline Array::Body & Array::exposedBody() {
+        Body & b = body();
+        b.shareable = false;
+        return b;
+    }
+
+    inline void Array::disableSharing() {
+        body().shareable = false;
+    }
+
+    inline std::string const & Array::comment() const {
+        return body_ == nullptr || body_->comment == nullptr ? detail::noComment() : *body_->comment;
+    }
+
+    inline void Array::setComment(std::string_view comment) {
+        if (comment.empty() && this->comment().empty())
+            return;
+        Body & b = body();
+        if (comment.empty())
+            b.comment.reset();
+        else if (b.comment == nullptr)
+            b.comment.reset(new std::string{comment});
+        else
+            *b.comment = comment;
     }
 
+    inline size_t Array::size() const { return body_ == nullptr ? 0 : body_->elements.size(); }
+
+    inline Value const & Array::operator [] (size_t i) const { return body_->elements[i]; }
+    inline Value & Array::operator [] (size_t i) { return exposedBody().elements[i]; }
+
+    inline Value const * Array::begin() const { return body_ == nullptr ? nullptr : body_->elements.data(); }
+    inline Value const * Array::end() const { return body_ == nullptr ? nullptr : body_->elements.data() + body_->elements.size(); }
+    inline Value * Array::begin() { return body_ == nullptr ? nullptr : exposedBody().elements.data(); }
+    inline Value * Array::end() { return body_ == nullptr ? nullptr : exposedBody().elements.data() + body_->elements.size(); }
+
     inline void Array::add(Value const & value) {
-        elements_.push_back(new Value{value});
+        body().elements.push_back(value);
     }
 
     inline void Array::add(Value && value) {
-        elements_.push_back(new Value{std::move(value)});
+        Body & b = body();
+        if (! value.shareable())
+            b.shareable = false;
+        b.elements.push_back(std::move(value));
+    }
+
+    inline bool Array::operator == (Array const & other) const {
+        size_t n = size();
+        if (n != other.size())
+            return false;
+        for (size_t i = 0; i < n; ++i)
+            if (! ((*this)[i] == other[i]))
+                return false;
+        return true;
+    }
+
+    /** Struct field. 
+     
+        The field does not manage its name, because it does not know the memory resource the name's characters come from. Owned names are copied and freed by the struct. 
+     */
+    struct Struct::Field {
+        char const * name;
+        uint32_t size;
+        // true if the name is in a key table, false if owned by the struct
+        bool interned;
+        Value value;
+
+        std::string_view view() const { return std::string_view{name, size}; }
+    }; // json::Struct::Field
+
+    struct Struct::Body {
+        explicit Body(std::pmr::memory_resource * resource, bool shareable = false):
+            shareable{shareable},
+            fields(resource),
+            index(resource) {
+        }
+
+        // number of structs sharing the body
+        std::atomic<uint32_t> refs{1};
+        // only bodies in the default resource that own all their field names and have not handed out references to their fields can be shared, others may not outlive their resource or key table, or may be modified through the references
+        bool shareable;
+        // fields never move once added so that references to them stay valid
+        detail::StableVector<Field> fields;
+        // open addressing hash table of field index + 1, 0 being empty slot, size is either 0 for small structs, or power of two at least twice the number of fields
+        std::pmr::vector<uint32_t> index;
+        std::unique_ptr<std::string> comment;
+    }; // json::Struct::Body
+
+    inline Struct::Struct(std::pmr::memory_resource * resource):
+        header_{Kind::Struct},
+        body_{resource == std::pmr::get_default_resource() ? nullptr : detail::create<Body>(resource, resource)} {
+    }
+
+    inline Struct::Struct(Struct const & from):
+        header_{from.header_},
+        body_{nullptr} {
+        if (from.size() == 0 && from.comment().empty())
+            return;
+        if (from.body_->shareable) {
+            from.body_->refs.fetch_add(1, std::memory_order_relaxed);
+            body_ = from.body_;
+        } else {
+            body_ = copy(*from.body_);
+        }
     }
 
     inline Struct::~Struct() {
-        for (auto e : elements_) 
-            delete e.second;
+        release(body_);
+    }
+
+    inline Struct::Body & Struct::body() {
+        if (body_ == nullptr) {
+            body_ = detail::create<Body>(std::pmr::get_default_resource(), std::pmr::get_default_resource(), true);
+        } else if (body_->refs.load(std::memory_order_acquire) != 1) {
+            Body * b = copy(*body_);
+            release(body_);
+            body_ = b;
+        }
+        return *body_;
+    }
+
+    inline Struct::Body * Struct::copy(Body const & from) {
+        // build the copy in a temporary so that it is freed if anything throws
+        Struct result;
+        Body & b = result.body();
+        std::pmr::memory_resource * resource = b.fields.resource();
+        b.index = from.index;
+        if (from.comment != nullptr)
+            b.comment.reset(new std::string{*from.comment});
+        for (size_t i = 0, e = from.fields.size(); i < e; ++i) {
+            Field const & f = from.fields[i];
+            char * name = static_cast<char *>(resource->allocate(f.size, 1));
+            std::memcpy(name, f.name, f.size);
+            b.fields.push_back(Field{name, f.size, false, Value{Undefined{}}}).value = f.value;
+        }
+        Body * body = result.body_;
+        result.body_ = nullptr;
+        return body;
+    }
+
+    inline void Struct::release(Body * body) {
+        if (body == nullptr || body->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        std::pmr::memory_resource * resource = body->fields.resource();
+        for (size_t i = 0, e = body->fields.size(); i < e; ++i) {
+            Field const & f = body->fields[i];
+            if (! f.interned)
+                resource->deallocate(const_cast<char *>(f.name), f.size, 1);
+        }
+        detail::destroy(resource, body);
+    }
+
+    inline Struct::Body & Struct::exposedBody() {
+        Body & b = body();
+        b.shareable = false;
+        return b;
     }
 
+    inline void Struct::disableSharing() {
+        body().shareable = false;
+    }
+
+    inline std::string const & Struct::comment() const {
+        return body_ == nullptr || body_->comment == nullptr ? detail::noComment() : *body_->comment;
+    }
 
-    inline Value const & Struct::operator [] (std::string const & i) const {
-        auto it = elementsByName_.find(i);
-        if (it == elementsByName_.end())
-            return json::undefined;
+    inline void Struct::setComment(std::string_view comment) {
+        if (comment.empty() && this->comment().empty())
+            return;
+        Body & b = body();
+        if (comment.empty())
+            b.comment.reset();
+        else if (b.comment == nullptr)
+            b.comment.reset(new std::string{comment});
         else
-            return *elements_[it->second].second;
+            *b.comment = comment;
+    }
+
+    inline size_t Struct::size() const { return body_ == nullptr ? 0 : body_->fields.size(); }
+
+    inline std::string_view Struct::key(size_t i) const { return body_->fields[i].view(); }
+
+    inline Value const & Struct::operator [] (size_t i) const { return body_->fields[i].value; }
+    inline Value & Struct::operator [] (size_t i) { return exposedBody().fields[i].value; }
+
+    inline Value const & Struct::operator [] (std::string_view name) const {
+        size_t i = find(name);
+        return i == size() ? json::undefined : body_->fields[i].value;
+    }
+
+    inline Value & Struct::operator [] (std::string_view name) {
+        Value & result = field(name);
+        body_->shareable = false;
+        return result;
+    }
+
+    inline Value & Struct::operator [] (Key key) {
+        Value & result = field(key);
+        body_->shareable = false;
+        return result;
+    }
+
+    inline Value & Struct::field(std::string_view name) {
+        size_t i = find(name);
+        Body & b = body();
+        if (i == b.fields.size()) {
+            std::pmr::memory_resource * resource = b.fields.resource();
+            char * chars = static_cast<char *>(resource->allocate(name.size(), 1));
+            std::memcpy(chars, name.data(), name.size());
+            try {
+                b.fields.push_back(Field{chars, static_cast<uint32_t>(name.size()), false, Value{Undefined{}}});
+            } catch (...) {
+                resource->deallocate(chars, name.size(), 1);
+                throw;
+            }
+            addToIndex(i);
+        }
+        return b.fields[i].value;
+    }
+
+    inline Value & Struct::field(Key key) {
+        std::string_view name = key.name();
+        size_t i = find(name);
+        Body & b = body();
+        if (i == b.fields.size()) {
+            b.fields.push_back(Field{name.data(), static_cast<uint32_t>(name.size()), true, Value{Undefined{}}});
+            b.shareable = false;
+            addToIndex(i);
+        }
+        return b.fields[i].value;
+    }
+
+    inline void Struct::set(std::string_view name, Value const & value) { field(name) = value; }
+    inline void Struct::set(std::string_view name, Value && value) {
+        Value & result = field(name);
+        if (! value.shareable())
+            body_->shareable = false;
+        result = std::move(value);
+    }
+
+    inline bool Value::shareable() const {
+        switch (kind()) {
+            case Kind::String:
+                return ! valueString_.borrowed();
+            case Kind::Array:
+                return valueArray_.body_ == nullptr || valueArray_.body_->shareable;
+            case Kind::Struct:
+                return valueStruct_.body_ == nullptr || valueStruct_.body_->shareable;
+            default:
+                return true;
+        }
+    }
+
+    inline bool Struct::operator == (Struct const & other) const {
+        size_t n = size();
+        if (n != other.size())
+            return false;
+        for (size_t i = 0; i < n; ++i)
+            if (key(i) != other.key(i) || ! ((*this)[i] == other[i]))
+                return false;
+        return true;
     }
 
-    inline Value & Struct::operator [] (std::string const & i) {
-        auto it = elementsByName_.find(i);
-        if (it == elementsByName_.end()) {
-            it = elementsByName_.insert(std::make_pair(i, elementsByName_.size())).first;
-            elements_.push_back(std::make_pair(i, new Value{Undefined{}}));
+    inline size_t Struct::find(std::string_view name) const {
+        if (body_ == nullptr)
+            return 0;
+        detail::StableVector<Field> const & fields = body_->fields;
+        std::pmr::vector<uint32_t> const & index = body_->index;
+        auto matches = [&](Field const & f) {
+            if (f.name == name.data() && f.size == name.size())
+                return true;
+            return f.size == name.size() && std::memcmp(f.name, name.data(), name.size()) == 0;
+        };
+        if (index.empty()) {
+            for (size_t i = 0, e = fields.size(); i < e; ++i)
+                if (matches(fields[i]))
+                    return i;
+            return fields.size();
+        }
+        size_t mask = index.size() - 1;
+        for (size_t h = std::hash<std::string_view>{}(name) & mask; ; h = (h + 1) & mask) {
+            uint32_t slot = index[h];
+            if (slot == 0)
+                return fields.size();
+            if (matches(fields[slot - 1]))
+                return slot - 1;
         }
-        return *elements_[it->second].second;
     }
 
-    inline void Struct::set(std::string const & name, Value const & value) { (*this)[name] = value; }
-    inline void Struct::set(std::string const & name, Value && value) { (*this)[name] = std::move(value); }
+    inline void Struct::addToIndex(size_t i) {
+        detail::StableVector<Field> & fields = body_->fields;
+        std::pmr::vector<uint32_t> & index = body_->index;
+        size_t n = fields.size();
+        if (n <= SmallSize)
+            return;
+        if (n * 2 > index.size()) {
+            size_t size = std::max(index.size() * 2, size_t{8});
+            while (size < n * 2)
+                size *= 2;
+            index.assign(size, 0);
+            for (size_t j = 0; j < i; ++j)
+                addToIndex(j);
+        }
+        size_t mask = index.size() - 1;
+        size_t h = std::hash<std::string_view>{}(fields[i].view()) & mask;
+        while (index[h] != 0)
+            h = (h + 1) & mask;
+        index[h] = static_cast<uint32_t>(i + 1);
+    }
 
     /** A rather simle and permissive JSON parser. 
      
         Aside from the proper JSON it also supports comments, trailing commas, literal names and so on. 
+
+        The parser works on a contiguous buffer of characters and advances a raw pointer through it. When parsing from a stream, the stream is read in large chunks into an internal buffer that is parsed the same way. Line and column information is only calculated when an error is reported. 
         */
     class Value::Parser {
+        friend class json::Reader;
+        friend class json::Lazy;
+        template<typename HANDLER> friend class json::ChunkedParser;
     public:
         
         class Token {
             friend class Parser;
+            friend class json::Reader;
+            friend class json::Lazy;
+            template<typename HANDLER> friend class json::ChunkedParser;
         public:
             enum class Kind {
                 Undefined, 
                 Null,
                 Bool,
                 Int,
+                Int64,
+                UInt64,
                 Double,
                 String, 
                 Comment, 
@@ -727,96 +2114,102 @@ namespace json {
                 CurlyClose,
             }; // json::Value::Parser::Token::Kind
 
-            Token(size_t l, size_t c, Kind kind):
-                line{l}, col{c}, kind{kind}, valueBool_{false} {
+            Token(Kind kind):
+                kind{kind}, valueBool_{false} {
             }
 
-            Token(size_t l, size_t c, Kind kind, bool value):
-                line{l}, col{c}, kind{kind}, valueBool_{value} {
+            Token(Kind kind, bool value):
+                kind{kind}, valueBool_{value} {
             }
 
-            Token(size_t l, size_t c, Kind kind, int value):
-                line{l}, col{c}, kind{kind}, valueInt_{value} {
+            Token(Kind kind, int value):
+                kind{kind}, valueInt_{value} {
             }
 
-            Token(size_t l, size_t c, Kind kind, double value):
-                line{l}, col{c}, kind{kind}, valueDouble_{value} {
+            Token(Kind kind, int64_t value):
+                kind{kind}, valueInt64_{value} {
             }
 
-            Token(size_t l, size_t c, Kind kind, std::string && value):
-                line{l}, col{c}, kind{kind}, valueString_{std::move(value)} {
+            Token(Kind kind, uint64_t value):
+                kind{kind}, valueUInt64_{value} {
             }
 
-            ~Token() {
-                detach();
+            Token(Kind kind, double value):
+                kind{kind}, valueDouble_{value} {
             }
 
-            Token & operator = (Token && from) {
-                detach();
-                line = from.line;
-                col = from.col;
-                kind = from.kind;
-                switch (kind) {
-                    case Kind::Identifier:
-                    case Kind::String:
-                    case Kind::Comment:
-                        new (&valueString_) std::string{std::move(from.valueString_)};
-                        break;
-                    case Kind::Bool:
-                        valueBool_ = from.valueBool_;
-                        break;
-                    case Kind::Double:
-                        valueDouble_ = from.valueDouble_;
-                        break;
-                    default:
-                        valueInt_ = from.valueInt_;
-                }
-                return *this;
+            /** String, identifier and comment tokens only reference their contents, which are either in the input buffer, or in the parser's scratch string. The contents are thus only valid until the next token is read.
+             */
+            Token(Kind kind, std::string_view value):
+                kind{kind}, valueString_{value} {
             }
 
-            size_t line;
-            size_t col;
-
             Kind kind;
 
         private:
 
-            void detach() {
-                using namespace std;
-                switch (kind) {
-                    case Kind::Identifier:
-                    case Kind::String:
-                    case Kind::Comment:
-                        valueString_.~string();
-                        break;
-                    default: // no need to detach anyting in this case
-                        break;
-                }
-            }
-
             union {
                 bool valueBool_;
                 int valueInt_;
+                int64_t valueInt64_;
+                uint64_t valueUInt64_;
                 double valueDouble_;
-                std::string valueString_;
+                std::string_view valueString_;
             }; 
             
         }; // json::Value::Parser::Token
 
+        /** Creates parser for the given contiguous input. 
+         
+            The input is not copied and must outlive the parser. If borrowStrings is true, strings that do not contain escape sequences borrow their characters from the input, which then has to outlive the parsed value as well. If an arena is given, arrays, structs and the characters of strings that are not borrowed from the input are allocated from it, and the arena must outlive the parsed value.  
+         */
+        Parser(char const * begin, char const * end, bool borrowStrings = false, std::pmr::memory_resource * arena = nullptr):
+            borrowStrings_{borrowStrings},
+            arena_{arena},
+            begin_{begin},
+            pos_{begin},
+            end_{end},
+            block_{begin},
+            blockEnd_{begin} {
+        }
+
+        /** Creates parser that reads from the given stream. 
+         
+            The stream is read in chunks of ChunkSize bytes into an internal buffer, which means that the parser may consume characters past the end of the parsed value. 
+         */
         Parser(std::istream & s):
-            s_{s} {
+            s_{&s} {
+        }
+
+        /** Interns struct field names in the given key table from now on. 
+         */
+        void internKeys(KeyTable * keys) {
+            keys_ = keys;
         }
 
         Value parse() {
             return parse(next());
         }
 
+        /** Parses the next value and reports it to the given handler as a sequence of events. 
+         
+            See json::parse(std::string_view, HANDLER &) for the handler requirements.
+         */
+        template<typename HANDLER>
+        void parseEvents(HANDLER & handler) {
+            parseEvents(next(), handler);
+        }
+
     private:
 
+        /** Number of bytes read from the input stream at once. 
+         */
+        static constexpr size_t ChunkSize = 256 * 1024;
+
         Value parse(Token const & t) {
             switch (t.kind) {
                 case Token::Kind::Comment:
-                    return parseWithComment(t.valueString_);
+                    return parseWithComment(std::string{t.valueString_});
                 case Token::Kind::Undefined:
                     return Undefined{};
                 case Token::Kind::Null:
@@ -825,13 +2218,27 @@ namespace json {
                     return Value{t.valueBool_};
                 case Token::Kind::Int:
                     return Value{t.valueInt_};
+                case Token::Kind::Int64:
+                    return Value{t.valueInt64_};
+                case Token::Kind::UInt64:
+                    return Value{t.valueUInt64_};
                 case Token::Kind::Double:
                     return Value{t.valueDouble_};
                 case Token::Kind::String:
+                    if (borrowStrings_ && t.valueString_.data() != string_.data())
+                        return Value{String::borrow(t.valueString_)};
+                    if (arena_ != nullptr) {
+                        char * chars = static_cast<char *>(arena_->allocate(t.valueString_.size(), 1));
+                        std::memcpy(chars, t.valueString_.data(), t.valueString_.size());
+                        return Value{String::borrow(std::string_view{chars, t.valueString_.size()})};
+                    }
                     return Value{t.valueString_};
                 // '[' [ value  { ',' value } [ ',' ] ] ']'
                 case Token::Kind::SquareOpen: {
-                    Array i{};
+                    Array i{resource()};
+                    // copies must own borrowed strings and interned keys, which nested values may hold as well
+                    if (borrowStrings_ || keys_ != nullptr)
+                        i.disableSharing();
                     Token t = next();
                     if (t.kind != Token::Kind::SquareClose) {
                         i.add(parse(t));
@@ -844,13 +2251,16 @@ namespace json {
                             t = next();
                         }
                         if (t.kind != Token::Kind::SquareClose) 
-                            throw "error";
+                            error("Expected , or ]");
                     }
                     return i;
                 }
                 // '{' [ string | ident = value { ',' string | ident = value } [ ',' ] ] '}'
                 case Token::Kind::CurlyOpen: {
-                    Struct i{};
+                    Struct i{resource()};
+                    // copies must own borrowed strings and interned keys, which nested values may hold as well
+                    if (borrowStrings_ || keys_ != nullptr)
+                        i.disableSharing();
                     Token t = next();
                     if (t.kind != Token::Kind::CurlyClose) {
                         addStructField(i, t);
@@ -863,247 +2273,2847 @@ namespace json {
                             t = next();
                         }            
                         if (t.kind != Token::Kind::CurlyClose) 
-                            throw "error";
+                            error("Expected , or }");
                     }
                     return i;
                 }
+                default:
+                    error("Expected value");
+            }
+        }
+
+        void addStructField(Struct & s, Token const & t) {
+            if (t.kind != Token::Kind::Identifier && t.kind != Token::Kind::String)
+                error("Expected identifier or a string");
+            // the field is added first since the name is only valid until the next token
+            Value & value = keys_ != nullptr ? s.field(keys_->intern(t.valueString_)) : s.field(t.valueString_);
+            if (next().kind != Token::Kind::Colon)
+                error("Expected colon");
+            value = parse(next());
+        }
+
+        /** Parses the value that follows a comment. Consecutive comments, such as the lines of a multi-line comment written as line comments, are joined by new lines.  
+         */
+        Value parseWithComment(std::string comment) {
+            Token t = next();
+            while (t.kind == Token::Kind::Comment) {
+                comment += '\n';
+                comment.append(t.valueString_);
+                t = next();
+            }
+            Value result = parse(t);
+            result.setComment(comment);
+            return result;
+        }
+
+        template<typename HANDLER>
+        void parseEvents(Token const & t, HANDLER & handler) {
+            switch (t.kind) {
+                case Token::Kind::Comment:
+                    handler.onComment(t.valueString_);
+                    parseEvents(next(), handler);
+                    return;
+                case Token::Kind::Undefined:
+                    handler.onUndefined();
+                    return;
+                case Token::Kind::Null:
+                    handler.onNull();
+                    return;
+                case Token::Kind::Bool:
+                    handler.onBool(t.valueBool_);
+                    return;
+                case Token::Kind::Int:
+                    handler.onInt(int64_t{t.valueInt_});
+                    return;
+                case Token::Kind::Int64:
+                    handler.onInt(t.valueInt64_);
+                    return;
+                case Token::Kind::UInt64:
+                    handler.onUInt(t.valueUInt64_);
+                    return;
+                case Token::Kind::Double:
+                    handler.onDouble(t.valueDouble_);
+                    return;
+                case Token::Kind::String:
+                    handler.onString(t.valueString_);
+                    return;
+                // '[' [ value  { ',' value } [ ',' ] ] ']'
+                case Token::Kind::SquareOpen: {
+                    handler.onStartArray();
+                    Token t = next();
+                    if (t.kind != Token::Kind::SquareClose) {
+                        parseEvents(t, handler);
+                        t = next();
+                        while (t.kind == Token::Kind::Comma) {
+                            t = next();
+                            if (t.kind == Token::Kind::SquareClose)
+                                break;
+                            parseEvents(t, handler);
+                            t = next();
+                        }
+                        if (t.kind != Token::Kind::SquareClose) 
+                            error("Expected , or ]");
+                    }
+                    handler.onEndArray();
+                    return;
+                }
+                // '{' [ string | ident = value { ',' string | ident = value } [ ',' ] ] '}'
+                case Token::Kind::CurlyOpen: {
+                    handler.onStartStruct();
+                    Token t = next();
+                    if (t.kind != Token::Kind::CurlyClose) {
+                        parseStructField(t, handler);
+                        t = next();
+                        while (t.kind == Token::Kind::Comma) {
+                            t = next();
+                            if (t.kind == Token::Kind::CurlyClose)
+                                break;
+                            parseStructField(t, handler);
+                            t = next();
+                        }            
+                        if (t.kind != Token::Kind::CurlyClose) 
+                            error("Expected , or }");
+                    }
+                    handler.onEndStruct();
+                    return;
+                }
+                default:
+                    error("Expected value");
+            }
+        }
+
+        template<typename HANDLER>
+        void parseStructField(Token const & t, HANDLER & handler) {
+            if (t.kind != Token::Kind::Identifier && t.kind != Token::Kind::String)
+                error("Expected identifier or a string");
+            handler.onKey(t.valueString_);
+            if (next().kind != Token::Kind::Colon)
+                error("Expected colon");
+            parseEvents(next(), handler);
+        }
+
+        /** Returns the next token in the input stream. 
+         
+            " => string
+            0-9 => number 
+            a-zA-Z_ => identifier
+            / => comment
+
+            */
+        Token next() {
+            if (! skipWhitespace())
+                error("Unexpected end of input");
+            char c = *pos_++;
+            switch (c) {
+                case ':':
+                    return Token{Token::Kind::Colon};
+                case ',':
+                    return Token{Token::Kind::Comma};
+                case '[':
+                    return Token{Token::Kind::SquareOpen};
+                case ']':
+                    return Token{Token::Kind::SquareClose};
+                case '{':
+                    return Token{Token::Kind::CurlyOpen};
+                case '}':
+                    return Token{Token::Kind::CurlyClose};
+                case '/':
+                    return Token{Token::Kind::Comment, nextComment()};
+                case '"':
+                case '\'':
+                    return Token{Token::Kind::String, nextString(c)};
+                case '-':
+                    --pos_;
+                    return nextNumber();
+                default:
+                    if (isDigit(c)) {
+                        --pos_;
+                        return nextNumber();
+                    }
+                    if (isIdentifierStart(c))
+                        return nextIdentifier(c);
+                    else
+                        error("Invalid JSON character");
+            }
+        }
+
+        /** Advances to the next non-whitespace character. Returns false if there is no more input. 
+         
+            Whole 64 byte blocks of the buffer are indexed at once into a bitmap of non-whitespace characters so that the parser can jump straight from one token to the next. Input shorter than a block at the end of the buffer is scanned byte by byte. 
+         */
+        bool skipWhitespace() {
+            while (true) {
+                if (pos_ < blockEnd_) {
+                    uint64_t tokens = tokens_ >> (pos_ - block_);
+                    if (tokens != 0) {
+                        pos_ += detail::countTrailingZeros(tokens);
+                        return true;
+                    }
+                    pos_ = blockEnd_;
+                }
+                if (end_ - pos_ >= 64) {
+                    block_ = pos_;
+                    blockEnd_ = pos_ + 64;
+                    tokens_ = ~ detail::whitespaceMask(pos_);
+                    continue;
+                }
+                while (pos_ != end_) {
+                    if (! detail::isWhitespace(*pos_))
+                        return true;
+                    ++pos_;
+                }
+                if (! fill())
+                    return false;
+            }
+        }
+
+        std::string_view nextComment() {
+            string_.clear();
+            switch (nextChar()) {
+                case '/': // single line comment
+                    while (! eof()) {
+                        char c = *pos_++;
+                        if (c == '\n')
+                            break;
+                        string_ += c;
+                    }
+                    break;
+                case '*': // multi-line comment 
+                    while (true) {
+                        if (eof())
+                            error("Unterminated multi-line comment");
+                        char c = *pos_++;
+                        if (c == '*' && peekChar() == '/') {
+                            ++pos_;
+                            break;
+                        }
+                        string_ += c;
+                    }
+                    break;
+                default:
+                    error("Expected // or /* comment");
+            }
+            return string_;
+        }
+
+        /** Parses a string literal whose opening delimiter has already been read. 
+         
+            Searches for the closing delimiter or a backslash using SIMD. If the closing delimiter is found within the buffer and the string has no escape sequences, which is the common case, the string is returned as a view into the input buffer without being copied. Otherwise the string is decoded into the scratch string, still copying the runs between escape sequences at once.  
+         */
+        std::string_view nextString(char delimiter) {
+            char const * start = pos_;
+            pos_ = detail::findDelimiterOrEscape(pos_, end_, delimiter);
+            if (pos_ != end_ && *pos_ == delimiter) 
+                return std::string_view{start, static_cast<size_t>(pos_++ - start)};
+            string_.assign(start, pos_);
+            while (true) {
+                if (pos_ == end_) {
+                    if (! fill())
+                        error("Unterminated string literal");
+                } else if (*pos_ == delimiter) {
+                    ++pos_;
+                    return string_;
+                } else { // backslash
+                    ++pos_;
+                    char c = nextChar();
+                    switch (c) {
+                        case '"':
+                        case '\'':
+                        case '\\':
+                            string_ += c;
+                            break;
+                        case 't':
+                            string_ += '\t';
+                            break;
+                        case 'n':
+                            string_ += '\n';
+                            break;
+                        case 'r':
+                            string_ += '\r';
+                            break;
+                        case 'b':
+                            string_ += '\b';
+                            break;
+                        case 'f':
+                            string_ += '\f';
+                            break;
+                        case '/':
+                            string_ += '/';
+                            break;
+                        case 'u': {
+                            uint32_t cp = nextHex4();
+                            if (cp >= 0xdc00 && cp <= 0xdfff)
+                                error("Invalid surrogate pair");
+                            if (cp >= 0xd800 && cp <= 0xdbff) {
+                                if (nextChar() != '\\' || nextChar() != 'u')
+                                    error("Invalid surrogate pair");
+                                uint32_t low = nextHex4();
+                                if (low < 0xdc00 || low > 0xdfff)
+                                    error("Invalid surrogate pair");
+                                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                            }
+                            detail::appendUtf8(string_, cp);
+                            break;
+                        }
+                        case '\n':
+                            break;
+                        default:
+                            error("Invalid string escape sequence");
+                    }
+                }
+                char const * run = pos_;
+                pos_ = detail::findDelimiterOrEscape(pos_, end_, delimiter);
+                string_.append(run, pos_);
+            }
+        }
+
+        /** Parses the four hexadecimal digits of a \\u escape sequence. 
+         */
+        uint32_t nextHex4() {
+            uint32_t result = 0;
+            for (int i = 0; i < 4; ++i) {
+                char c = nextChar();
+                if (detail::isDigit(c))
+                    result = result * 16 + static_cast<uint32_t>(c - '0');
+                else if (c >= 'a' && c <= 'f')
+                    result = result * 16 + static_cast<uint32_t>(c - 'a' + 10);
+                else if (c >= 'A' && c <= 'F')
+                    result = result * 16 + static_cast<uint32_t>(c - 'A' + 10);
+                else
+                    error("Invalid unicode escape sequence");
+            }
+            return result;
+        }
+
+        /** Parses an identifier. 
+         */
+        Token nextIdentifier(char start) {
+            string_.assign(1, start);
+            while (! eof() && isIdentifier(*pos_))
+                string_ += *pos_++;
+            if (string_ == "null")
+                return Token{Token::Kind::Null};
+            else if (string_ == "undefined")
+                return Token{Token::Kind::Undefined};
+            else if (string_ == "true")
+                return Token{Token::Kind::Bool, true};
+            else if (string_ == "false")
+                return Token{Token::Kind::Bool, false};
+            else
+                return Token{Token::Kind::Identifier, std::string_view{string_}};
+        }
+
+        /** Parses a number starting at the current position. 
+         
+            Makes sure the whole number is in the buffer first so that the number engine can work on a contiguous range. Integers are returned as Int if they fit, Int64 if they fit that, and UInt64 otherwise. 
+         */
+        Token nextNumber() {
+            char const * p = pos_;
+            while (true) {
+                while (p != end_ && detail::isNumberChar(*p))
+                    ++p;
+                if (p != end_ || s_ == nullptr)
+                    break;
+                size_t offset = static_cast<size_t>(p - pos_);
+                // fill moves the buffer even if there is nothing more to read
+                bool more = fill();
+                p = pos_ + offset;
+                if (! more)
+                    break;
+            }
+            detail::Number n;
+            p = detail::parseNumber(pos_, p, n);
+            if (p == nullptr)
+                error("Invalid number");
+            pos_ = p;
+            if (n.kind == detail::Number::Kind::Double)
+                return Token{Token::Kind::Double, n.valueDouble};
+            if (n.kind == detail::Number::Kind::UInt)
+                return Token{Token::Kind::UInt64, n.valueUInt};
+            if (n.valueInt >= std::numeric_limits<int>::min() && n.valueInt <= std::numeric_limits<int>::max())
+                return Token{Token::Kind::Int, static_cast<int>(n.valueInt)};
+            return Token{Token::Kind::Int64, n.valueInt};
+        }
+
+        /** Returns the next character and advances, or returns 0 if at the end of input. 
+         */
+        char nextChar() {
+            return eof() ? '\0' : *pos_++;
+        }
+
+        /** Returns the next character without advancing, or 0 if at the end of input. 
+         */
+        char peekChar() {
+            return eof() ? '\0' : *pos_;
+        }
+
+        /** Returns true if there is no more input. 
+         
+            When at the end of the buffer, tries to read more from the input stream first. 
+         */
+        bool eof() {
+            return pos_ == end_ && ! fill();
+        }
+
+        /** Reads next chunk of the input stream into the buffer, discarding the already parsed input. 
+         
+            Returns false if there is nothing more to read, or the parser is not reading from a stream. 
+         */
+        bool fill() {
+            if (s_ == nullptr || ! *s_)
+                return false;
+            std::tie(line_, col_) = location(pos_);
+            size_t kept = static_cast<size_t>(end_ - pos_);
+            if (capacity_ < kept + ChunkSize) {
+                capacity_ = std::max(capacity_ * 2, kept + ChunkSize);
+                std::unique_ptr<char[]> buffer{new char[capacity_]};
+                if (kept > 0)
+                    std::memcpy(buffer.get(), pos_, kept);
+                buffer_ = std::move(buffer);
+            } else {
+                std::memmove(buffer_.get(), pos_, kept);
+            }
+            s_->read(buffer_.get() + kept, static_cast<std::streamsize>(ChunkSize));
+            size_t n = static_cast<size_t>(s_->gcount());
+            begin_ = buffer_.get();
+            pos_ = begin_;
+            end_ = begin_ + kept + n;
+            block_ = begin_;
+            blockEnd_ = begin_;
+            return n > 0;
+        }
+
+        /** Moves to the given position in the contiguous input. 
+         */
+        void seek(char const * p) {
+            pos_ = p;
+            block_ = p;
+            blockEnd_ = p;
+        }
+
+        /** Returns the line and column of given position in the current buffer. 
+         */
+        std::pair<size_t, size_t> location(char const * p) const {
+            size_t line = line_;
+            size_t col = col_;
+            for (char const * i = begin_; i < p; ++i) {
+                if (*i == '\n') {
+                    ++line;
+                    col = 1;
+                } else {
+                    ++col;
+                }
+            }
+            return std::make_pair(line, col);
+        }
+
+        [[noreturn]] void error(char const * msg) {
+            auto l = location(pos_);
+            throw Error{msg, l.first, l.second};
+        }
+
+        bool isDigit(char c) { return detail::isDigit(c); }
+        bool isIdentifierStart(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+        bool isIdentifier(char c) { return isIdentifierStart(c) || isDigit(c); } 
+
+        std::pmr::memory_resource * resource() const {
+            return arena_ != nullptr ? arena_ : std::pmr::get_default_resource();
+        }
+
+        bool borrowStrings_ = false;
+        std::pmr::memory_resource * arena_ = nullptr;
+        // key table to intern struct field names in, if any
+        KeyTable * keys_ = nullptr;
+
+        char const * begin_ = nullptr;
+        char const * pos_ = nullptr;
+        char const * end_ = nullptr;
+
+        // the last indexed block and its bitmap of non-whitespace characters
+        char const * block_ = nullptr;
+        char const * blockEnd_ = nullptr;
+        uint64_t tokens_ = 0;
+
+        // location of begin_ for errors
+        size_t line_ = 1;
+        size_t col_ = 1;
+
+        // stream input, if any
+        std::istream * s_ = nullptr;
+        std::unique_ptr<char[]> buffer_;
+        size_t capacity_ = 0;
+
+        // scratch space for decoded strings, identifiers and comments
+        std::string string_;
+
+    }; // json::Value::Parser
+
+    /** Parses the given stream and returns the JSON object. 
+     */
+    inline Value parse(std::istream & s) {
+        Value::Parser p{s};
+        return p.parse();
+    }
+
+    /** Parses the given string and returns the JSON object. 
+     */
+    inline Value parse(std::string_view str) {
+        Value::Parser p{str.data(), str.data() + str.size()};
+        return p.parse();
+    }
+
+    /** Parses the given null terminated string and returns the JSON object. 
+     */
+    inline Value parse(char const * str) {
+        return parse(std::string_view{str});
+    }
+
+    /** Parses the given string and reports its contents to the handler as a sequence of events, without building a Value. 
+     
+        The handler is a template argument so that the event calls can be inlined. It must provide the following methods: 
+
+            void onUndefined();
+            void onNull();
+            void onBool(bool value);
+            void onInt(int64_t value);
+            void onUInt(uint64_t value);
+            void onDouble(double value);
+            void onString(std::string_view value);
+            void onKey(std::string_view name);
+            void onStartArray();
+            void onEndArray();
+            void onStartStruct();
+            void onEndStruct();
+            void onComment(std::string_view comment);
+
+        Integers above INT64_MAX are reported by onUInt(), all others by onInt(). Struct fields are reported as onKey() followed by the value events. A comment is reported before the value it belongs to. The string views passed to the handler are only valid for the duration of the call. The handler may throw to abort the parsing.  
+     */
+    template<typename HANDLER>
+    inline void parse(std::string_view str, HANDLER & handler) {
+        Value::Parser p{str.data(), str.data() + str.size()};
+        p.parseEvents(handler);
+    }
+
+    /** Parses the given stream and reports its contents to the handler as a sequence of events. 
+     
+        See parse(std::string_view, HANDLER &) for details. 
+     */
+    template<typename HANDLER>
+    inline void parse(std::istream & s, HANDLER & handler) {
+        Value::Parser p{s};
+        p.parseEvents(handler);
+    }
+
+    /** Forward-only pull reader. 
+     
+        Instead of parsing the whole input into a Value, the caller asks for the next token with next() and can either read its value, materialize the whole value with value(), or jump over it with skip(). Only the nesting of the currently open containers is kept, so inputs of any size can be read from a stream in constant memory: 
+
+            json::Reader r{stream};
+            r.next(); // StartArray
+            while (r.next() != json::Reader::Kind::EndArray) {
+                // r is at the start of the record
+                r.skip();
+            }
+
+        Comments are not reported as tokens. Instead comment() returns the comments that precede the current token. 
+     */
+    class Reader {
+    public:
+        enum class Kind {
+            Undefined, 
+            Null, 
+            Bool, 
+            Int, 
+            UInt,
+            Double, 
+            String, 
+            Key, 
+            StartArray, 
+            EndArray, 
+            StartStruct, 
+            EndStruct, 
+            End,
+        }; // json::Reader::Kind
+
+        /** Creates reader for the given contiguous input, which must outlive the reader. 
+         */
+        explicit Reader(std::string_view input):
+            parser_{input.data(), input.data() + input.size()} {
+        }
+
+        /** Creates reader that reads from the given stream in chunks. 
+         */
+        explicit Reader(std::istream & s):
+            parser_{s} {
+        }
+
+        /** Kind of the current token. End is returned before the first call to next() and after the top-level value has been read.  
+         */
+        Kind kind() const { return kind_; }
+
+        /** Number of currently open arrays and structs. 
+         */
+        size_t depth() const { return stack_.size(); }
+
+        /** Comments preceding the current token, if any. 
+         */
+        std::string const & comment() const { return comment_; }
+
+        bool asBool() {
+            if (kind_ != Kind::Bool)
+                parser_.error("Expected bool");
+            return token_.valueBool_;
+        }
+
+        int64_t asInt() {
+            if (token_.kind == Token::Kind::Int)
+                return token_.valueInt_;
+            if (token_.kind != Token::Kind::Int64)
+                parser_.error("Expected integer");
+            return token_.valueInt64_;
+        }
+
+        /** Returns the current integer that does not fit int64_t. 
+         */
+        uint64_t asUInt() {
+            if (kind_ != Kind::UInt)
+                parser_.error("Expected unsigned integer");
+            return token_.valueUInt64_;
+        }
+
+        /** Returns the current number as double. Integers are converted. 
+         */
+        double asDouble() {
+            if (token_.kind == Token::Kind::Double)
+                return token_.valueDouble_;
+            if (token_.kind == Token::Kind::UInt64)
+                return static_cast<double>(token_.valueUInt64_);
+            return static_cast<double>(asInt());
+        }
+
+        /** Returns the current string, or key. The view is only valid until next() is called.   
+         */
+        std::string_view asString() {
+            if (kind_ != Kind::String && kind_ != Kind::Key)
+                parser_.error("Expected string");
+            return token_.valueString_;
+        }
+
+        /** Advances to the next token and returns its kind. 
+         */
+        Kind next() {
+            comment_.clear();
+            switch (state_) {
+                case State::Start:
+                    return value(nextToken());
+                case State::AfterOpen: {
+                    Token t = nextToken();
+                    if (isClose(t))
+                        return close(t);
+                    return stack_.back() ? key(t) : value(t);
+                }
+                case State::AfterKey:
+                    if (nextToken().kind != Token::Kind::Colon)
+                        parser_.error("Expected colon");
+                    return value(nextToken());
+                case State::AfterValue: {
+                    if (stack_.empty()) {
+                        state_ = State::Done;
+                        return kind_ = Kind::End;
+                    }
+                    Token t = nextToken();
+                    if (t.kind == Token::Kind::Comma)
+                        t = nextToken();
+                    else if (! isClose(t))
+                        parser_.error(stack_.back() ? "Expected , or }" : "Expected , or ]");
+                    if (isClose(t))
+                        return close(t);
+                    return stack_.back() ? key(t) : value(t);
+                }
+                default:
+                    return kind_ = Kind::End;
+            }
+        }
+
+        /** Skips the current value without materializing it. 
+         
+            At the start of an array or struct, skips the whole container so that the current token becomes its end. At a key, skips the key's value. Does nothing for other tokens. Skipped containers are only checked for balanced brackets.  
+         */
+        void skip() {
+            if (kind_ == Kind::Key) {
+                if (nextToken().kind != Token::Kind::Colon)
+                    parser_.error("Expected colon");
+                Token t = nextToken();
+                state_ = State::AfterValue;
+                if (t.kind == Token::Kind::SquareOpen || t.kind == Token::Kind::CurlyOpen)
+                    skipContainer();
+                else if (isClose(t) || t.kind == Token::Kind::Colon || t.kind == Token::Kind::Comma)
+                    parser_.error("Expected value");
+            } else if (kind_ == Kind::StartArray || kind_ == Kind::StartStruct) {
+                stack_.pop_back();
+                skipContainer();
+                kind_ = kind_ == Kind::StartArray ? Kind::EndArray : Kind::EndStruct;
+                state_ = State::AfterValue;
+            }
+        }
+
+        /** Materializes the current value and advances past it. 
+         
+            At the start of an array or struct, parses the whole container so that the current token becomes its end. At a key, parses the key's value. The comments preceding the value are attached to it.   
+         */
+        Value value() {
+            Value result;
+            switch (kind_) {
+                case Kind::Key: {
+                    if (nextToken().kind != Token::Kind::Colon)
+                        parser_.error("Expected colon");
+                    Token t = nextToken();
+                    result = parser_.parse(t);
+                    state_ = State::AfterValue;
+                    break;
+                }
+                case Kind::StartArray:
+                case Kind::StartStruct:
+                    stack_.pop_back();
+                    result = parser_.parse(token_);
+                    kind_ = kind_ == Kind::StartArray ? Kind::EndArray : Kind::EndStruct;
+                    state_ = State::AfterValue;
+                    break;
+                case Kind::EndArray:
+                case Kind::EndStruct:
+                case Kind::End:
+                    parser_.error("Expected value");
+                default:
+                    result = parser_.parse(token_);
+            }
+            if (! comment_.empty())
+                result.setComment(comment_);
+            return result;
+        }
+
+    private:
+
+        using Token = Value::Parser::Token;
+
+        enum class State {
+            Start, 
+            AfterOpen, 
+            AfterKey, 
+            AfterValue, 
+            Done,
+        }; // json::Reader::State
+
+        /** Returns the next token that is not a comment. Comments are accumulated in comment_, consecutive ones joined by new lines. 
+         */
+        Token nextToken() {
+            Token t = parser_.next();
+            while (t.kind == Token::Kind::Comment) {
+                if (! comment_.empty())
+                    comment_ += '\n';
+                comment_.append(t.valueString_);
+                t = parser_.next();
+            }
+            return t;
+        }
+
+        bool isClose(Token const & t) const {
+            return t.kind == Token::Kind::SquareClose || t.kind == Token::Kind::CurlyClose;
+        }
+
+        Kind value(Token const & t) {
+            token_ = t;
+            state_ = State::AfterValue;
+            switch (t.kind) {
+                case Token::Kind::Undefined:
+                    return kind_ = Kind::Undefined;
+                case Token::Kind::Null:
+                    return kind_ = Kind::Null;
+                case Token::Kind::Bool:
+                    return kind_ = Kind::Bool;
+                case Token::Kind::Int:
+                case Token::Kind::Int64:
+                    return kind_ = Kind::Int;
+                case Token::Kind::UInt64:
+                    return kind_ = Kind::UInt;
+                case Token::Kind::Double:
+                    return kind_ = Kind::Double;
+                case Token::Kind::String:
+                    return kind_ = Kind::String;
+                case Token::Kind::SquareOpen:
+                    stack_.push_back(false);
+                    state_ = State::AfterOpen;
+                    return kind_ = Kind::StartArray;
+                case Token::Kind::CurlyOpen:
+                    stack_.push_back(true);
+                    state_ = State::AfterOpen;
+                    return kind_ = Kind::StartStruct;
+                default:
+                    parser_.error("Expected value");
+            }
+        }
+
+        Kind key(Token const & t) {
+            if (t.kind != Token::Kind::Identifier && t.kind != Token::Kind::String)
+                parser_.error("Expected identifier or a string");
+            token_ = t;
+            state_ = State::AfterKey;
+            return kind_ = Kind::Key;
+        }
+
+        Kind close(Token const & t) {
+            bool isStruct = t.kind == Token::Kind::CurlyClose;
+            if (stack_.back() != isStruct)
+                parser_.error(stack_.back() ? "Expected }" : "Expected ]");
+            stack_.pop_back();
+            state_ = State::AfterValue;
+            return kind_ = isStruct ? Kind::EndStruct : Kind::EndArray;
+        }
+
+        /** Skips tokens until the container that has just been opened is closed. 
+         */
+        void skipContainer() {
+            size_t depth = 1;
+            while (depth > 0) {
+                switch (parser_.next().kind) {
+                    case Token::Kind::SquareOpen:
+                    case Token::Kind::CurlyOpen:
+                        ++depth;
+                        break;
+                    case Token::Kind::SquareClose:
+                    case Token::Kind::CurlyClose:
+                        --depth;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        Value::Parser parser_;
+        Token token_{Token::Kind::Undefined};
+        Kind kind_ = Kind::End;
+        State state_ = State::Start;
+        // true for structs, false for arrays
+        std::vector<bool> stack_;
+        std::string comment_;
+
+    }; // json::Reader
+
+    /** Value that is parsed on demand. 
+     
+        The lazy value only remembers where in the input it starts. Accessing a struct field, or an array element scans forward in the container only as far as necessary and remembers the extents of the values it has skipped over, so that subsequent accesses do not rescan. The skipped values are not materialized, only their brackets are balanced. Use value() to get the json::Value of any part of the input: 
+
+            json::Lazy doc{body};
+            int id = doc["id"].value().as<json::Int>(); 
+
+        Like the parser, the lazy value keeps integers as Int when they fit, so check kind() first if the value may be larger. 
+
+        The input must outlive the lazy value and all values obtained from it. Since the input is only scanned as far as needed, errors past the accessed parts of the input are not reported. Unlike the parser, which keeps the last one, lookup of a duplicate key returns its first occurence. 
+
+        The accessors are const and return const references, because the parts of the input cannot be modified. They still update the scanned extents, so a lazy value must not be accessed from multiple threads at once. 
+     */
+    class Lazy {
+    public:
+
+        /** Creates undefined lazy value. 
+         */
+        Lazy() = default;
+
+        explicit Lazy(std::string_view input):
+            Lazy{input.data(), input.data(), input.data() + input.size()} {
+        }
+
+        Lazy(Lazy &&) = default;
+        Lazy & operator = (Lazy &&) = default;
+
+        Value::Kind kind() const {
+            start();
+            return kind_;
+        }
+
+        /** Returns the field with given name, or undefined if the struct does not have it. 
+         */
+        Lazy const & operator [] (std::string_view name) const {
+            if (kind() != Value::Kind::Struct)
+                error("Expected struct");
+            for (size_t i = 0; i < keys_.size(); ++i)
+                if (keys_[i] == name)
+                    return *elements_[i];
+            while (scanNext()) {
+                if (keys_.back() == name)
+                    return *elements_.back();
+            }
+            return undefined();
+        }
+
+        /** Returns the i-th element of an array or a struct, or undefined if there is not enough elements. 
+         */
+        Lazy const & operator [] (size_t i) const {
+            if (kind() != Value::Kind::Array && kind_ != Value::Kind::Struct)
+                error("Expected array or struct");
+            while (elements_.size() <= i)
+                if (! scanNext())
+                    return undefined();
+            return *elements_[i];
+        }
+
+        /** Returns the name of the i-th field of a struct. 
+         */
+        std::string const & key(size_t i) const {
+            if (kind() != Value::Kind::Struct)
+                error("Expected struct");
+            while (keys_.size() <= i)
+                if (! scanNext())
+                    error("Field index out of bounds");
+            return keys_[i];
+        }
+
+        /** Returns the number of elements of an array or a struct. Scans the entire container. 
+         */
+        size_t size() const {
+            if (kind() != Value::Kind::Array && kind_ != Value::Kind::Struct)
+                return 0;
+            while (scanNext()) {
+            }
+            return elements_.size();
+        }
+
+        /** Parses the value, including any comments that precede it.  
+         */
+        Value value() const {
+            if (begin_ == nullptr)
+                return Undefined{};
+            Value::Parser p{input_, end_};
+            p.seek(begin_);
+            return p.parse();
+        }
+
+    private:
+
+        using Token = Value::Parser::Token;
+
+        Lazy(char const * input, char const * begin, char const * end):
+            input_{input},
+            begin_{begin},
+            end_{end} {
+        }
+
+        static Lazy const & undefined() {
+            static Lazy const result;
+            return result;
+        }
+
+        /** Determines the kind of the value and for containers where their contents start. 
+         */
+        void start() const {
+            if (started_ || begin_ == nullptr)
+                return;
+            Value::Parser p{input_, end_};
+            p.seek(begin_);
+            Token t = nextToken(p);
+            switch (t.kind) {
+                case Token::Kind::Undefined:
+                    kind_ = Value::Kind::Undefined;
+                    break;
+                case Token::Kind::Null:
+                    kind_ = Value::Kind::Null;
+                    break;
+                case Token::Kind::Bool:
+                    kind_ = Value::Kind::Bool;
+                    break;
+                case Token::Kind::Int:
+                    kind_ = Value::Kind::Int;
+                    break;
+                case Token::Kind::Int64:
+                    kind_ = Value::Kind::Int64;
+                    break;
+                case Token::Kind::UInt64:
+                    kind_ = Value::Kind::UInt64;
+                    break;
+                case Token::Kind::Double:
+                    kind_ = Value::Kind::Double;
+                    break;
+                case Token::Kind::String:
+                    kind_ = Value::Kind::String;
+                    break;
+                case Token::Kind::SquareOpen:
+                    kind_ = Value::Kind::Array;
+                    break;
+                case Token::Kind::CurlyOpen:
+                    kind_ = Value::Kind::Struct;
+                    break;
+                default:
+                    p.error("Expected value");
+            }
+            scan_ = p.pos_;
+            complete_ = kind_ != Value::Kind::Array && kind_ != Value::Kind::Struct;
+            started_ = true;
+        }
+
+        /** Finds the extent of the next element of the container. Returns false if there are no more elements. 
+         */
+        bool scanNext() const {
+            if (complete_)
+                return false;
+            bool isStruct = kind_ == Value::Kind::Struct;
+            Value::Parser p{input_, end_};
+            p.seek(scan_);
+            char const * elementBegin = scan_;
+            Token t = nextToken(p);
+            if (! elements_.empty()) {
+                if (t.kind == Token::Kind::Comma) {
+                    elementBegin = p.pos_;
+                    t = nextToken(p);
+                } else if (t.kind != (isStruct ? Token::Kind::CurlyClose : Token::Kind::SquareClose)) {
+                    p.error(isStruct ? "Expected , or }" : "Expected , or ]");
+                }
+            }
+            if (t.kind == (isStruct ? Token::Kind::CurlyClose : Token::Kind::SquareClose)) {
+                complete_ = true;
+                return false;
+            }
+            if (isStruct) {
+                if (t.kind != Token::Kind::Identifier && t.kind != Token::Kind::String)
+                    p.error("Expected identifier or a string");
+                keys_.emplace_back(t.valueString_);
+                if (nextToken(p).kind != Token::Kind::Colon)
+                    p.error("Expected colon");
+                elementBegin = p.pos_;
+                t = nextToken(p);
+            }
+            switch (t.kind) {
+                case Token::Kind::SquareOpen:
+                case Token::Kind::CurlyOpen:
+                    skipContainer(p);
+                    break;
+                case Token::Kind::Undefined:
+                case Token::Kind::Null:
+                case Token::Kind::Bool:
+                case Token::Kind::Int:
+                case Token::Kind::Int64:
+                case Token::Kind::UInt64:
+                case Token::Kind::Double:
+                case Token::Kind::String:
+                    break;
+                default:
+                    p.error("Expected value");
+            }
+            elements_.push_back(std::unique_ptr<Lazy>{new Lazy{input_, elementBegin, end_}});
+            scan_ = p.pos_;
+            return true;
+        }
+
+        static Token nextToken(Value::Parser & p) {
+            Token t = p.next();
+            while (t.kind == Token::Kind::Comment)
+                t = p.next();
+            return t;
+        }
+
+        /** Skips tokens until the container that has just been opened is closed. 
+         */
+        static void skipContainer(Value::Parser & p) {
+            size_t depth = 1;
+            while (depth > 0) {
+                switch (p.next().kind) {
+                    case Token::Kind::SquareOpen:
+                    case Token::Kind::CurlyOpen:
+                        ++depth;
+                        break;
+                    case Token::Kind::SquareClose:
+                    case Token::Kind::CurlyClose:
+                        --depth;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        [[noreturn]] void error(char const * msg) const {
+            Value::Parser p{input_, end_};
+            p.seek(begin_);
+            p.error(msg);
+        }
+
+        // beginning of the whole input for error locations, start of the value (before any comments) and end of the input
+        char const * input_ = nullptr;
+        char const * begin_ = nullptr;
+        char const * end_ = nullptr;
+
+        // the rest only caches what has been scanned so far, so that it can be updated by the const accessors
+        mutable bool started_ = false;
+        mutable bool complete_ = true;
+        mutable Value::Kind kind_ = Value::Kind::Undefined;
+
+        // where the next element of a container starts
+        mutable char const * scan_ = nullptr;
+        mutable std::vector<std::unique_ptr<Lazy>> elements_;
+        mutable std::vector<std::string> keys_;
+
+    }; // json::Lazy
+
+    class TapeView;
+
+    /** Read-only document stored as a flat tape. 
+     
+        The whole input is parsed in a single pass into a vector of 64bit words and a buffer of string characters, instead of a tree of values. Each word holds a tag in its top byte and a payload in the rest. Containers are delimited by start and end words that point at each other, so that containers can be skipped over in constant time, and the start word also holds the number of elements, up to 2^24 - 1. Int64, UInt64 and double values keep their value in the word that follows, strings and keys store the offset of their size and characters in the string buffer. 
+
+        The tape is navigated by TapeView, which mirrors the read-only API of Value: 
+
+            json::Tape doc{input};
+            for (json::TapeView item : doc.root()["items"])
+                total += item["price"].asDouble();
+
+        Strings are copied to the tape, so the input does not have to outlive it. Comments are ignored. 
+     */
+    class Tape {
+    public:
+        explicit Tape(std::string_view input) {
+            // a word per 16 bytes of input underestimates typical JSON, so the reservation stays below the input size and the vectors grow past it only when needed
+            words_.reserve(input.size() / 16 + 2);
+            strings_.reserve(input.size() / 4);
+            Reader r{input};
+            // start words of the open containers and their element counts
+            std::vector<std::pair<size_t, size_t>> open;
+            for (Reader::Kind k = r.next(); k != Reader::Kind::End; k = r.next()) {
+                if (k == Reader::Kind::Key) {
+                    ++open.back().second;
+                    add(Tag::String, addString(r.asString()));
+                    continue;
+                }
+                if (k == Reader::Kind::EndArray || k == Reader::Kind::EndStruct) {
+                    auto [start, count] = open.back();
+                    open.pop_back();
+                    size_t end = words_.size();
+                    if (end > 0xffffffff)
+                        throw std::length_error{"Tape too long"};
+                    words_[start] |= std::min(count, MaxCount) << 32 | end;
+                    add(k == Reader::Kind::EndArray ? Tag::EndArray : Tag::EndStruct, start);
+                    continue;
+                }
+                if (! open.empty() && tag(open.back().first) == Tag::StartArray)
+                    ++open.back().second;
+                switch (k) {
+                    case Reader::Kind::Undefined:
+                        add(Tag::Undefined);
+                        break;
+                    case Reader::Kind::Null:
+                        add(Tag::Null);
+                        break;
+                    case Reader::Kind::Bool:
+                        add(r.asBool() ? Tag::True : Tag::False);
+                        break;
+                    case Reader::Kind::Int: {
+                        int64_t value = r.asInt();
+                        if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max()) {
+                            add(Tag::Int, static_cast<uint32_t>(value));
+                        } else {
+                            add(Tag::Int64);
+                            words_.push_back(static_cast<uint64_t>(value));
+                        }
+                        break;
+                    }
+                    case Reader::Kind::UInt:
+                        add(Tag::UInt64);
+                        words_.push_back(r.asUInt());
+                        break;
+                    case Reader::Kind::Double: {
+                        double value = r.asDouble();
+                        uint64_t bits;
+                        std::memcpy(&bits, &value, sizeof(bits));
+                        add(Tag::Double);
+                        words_.push_back(bits);
+                        break;
+                    }
+                    case Reader::Kind::String:
+                        add(Tag::String, addString(r.asString()));
+                        break;
+                    case Reader::Kind::StartArray:
+                    case Reader::Kind::StartStruct:
+                        open.emplace_back(words_.size(), 0);
+                        add(k == Reader::Kind::StartArray ? Tag::StartArray : Tag::StartStruct);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        /** Returns view of the top-level value. 
+         */
+        TapeView root() const;
+
+        /** Number of words in the tape. 
+         */
+        size_t size() const { return words_.size(); }
+
+    private:
+        friend class TapeView;
+
+        enum class Tag : uint8_t {
+            Undefined, 
+            Null, 
+            False, 
+            True, 
+            Int, 
+            Int64, 
+            UInt64, 
+            Double, 
+            String, 
+            StartArray, 
+            EndArray, 
+            StartStruct, 
+            EndStruct,
+        }; // json::Tape::Tag
+
+        static constexpr size_t MaxCount = 0xffffff;
+        static constexpr uint64_t PayloadMask = (uint64_t{1} << 56) - 1;
+
+        void add(Tag tag, uint64_t payload = 0) {
+            words_.push_back(static_cast<uint64_t>(tag) << 56 | payload);
+        }
+
+        /** Appends the string prefixed by its size to the string buffer and returns its offset. 
+         */
+        size_t addString(std::string_view str) {
+            if (str.size() > 0xffffffff)
+                throw std::length_error{"String too long"};
+            size_t offset = strings_.size();
+            uint32_t size = static_cast<uint32_t>(str.size());
+            strings_.append(reinterpret_cast<char const *>(&size), sizeof(size));
+            strings_.append(str);
+            return offset;
+        }
+
+        Tag tag(size_t i) const { return static_cast<Tag>(words_[i] >> 56); }
+        uint64_t payload(size_t i) const { return words_[i] & PayloadMask; }
+
+        std::string_view string(size_t i) const {
+            size_t offset = payload(i);
+            uint32_t size;
+            std::memcpy(&size, strings_.data() + offset, sizeof(size));
+            return std::string_view{strings_.data() + offset + sizeof(size), size};
+        }
+
+        /** Returns the index of the word after the value starting at given index. 
+         */
+        size_t next(size_t i) const {
+            switch (tag(i)) {
+                case Tag::StartArray:
+                case Tag::StartStruct:
+                    return (payload(i) & 0xffffffff) + 1;
+                case Tag::Int64:
+                case Tag::UInt64:
+                case Tag::Double:
+                    return i + 2;
+                default:
+                    return i + 1;
+            }
+        }
+
+        std::vector<uint64_t> words_;
+        std::string strings_;
+
+    }; // json::Tape
+
+    /** Lightweight read-only view of a value in a Tape. 
+     
+        The view is only a pointer to the tape and an index to it, so it is cheap to copy and must not outlive its tape. Struct lookup by name and array indexing scan the container, so iterating over the elements is preferred for large containers. Missing fields and out of bounds elements return undefined view. 
+     */
+    class TapeView {
+    public:
+
+        /** Iterator over the elements of an array, or the values of a struct. 
+         */
+        class Iterator {
+        public:
+            TapeView operator * () const { 
+                return TapeView{tape_, isStruct_ ? i_ + 1 : i_}; 
+            }
+
+            /** Returns the name of the current field when iterating over a struct. 
+             */
+            std::string_view key() const { 
+                return tape_->string(i_); 
+            }
+
+            Iterator & operator ++ () {
+                i_ = tape_->next(isStruct_ ? i_ + 1 : i_);
+                return *this;
+            }
+
+            bool operator == (Iterator const & other) const { return i_ == other.i_; }
+            bool operator != (Iterator const & other) const { return i_ != other.i_; }
+
+        private:
+            friend class TapeView;
+
+            Iterator(Tape const * tape, size_t i, bool isStruct):
+                tape_{tape},
+                i_{i},
+                isStruct_{isStruct} {
+            }
+
+            Tape const * tape_;
+            size_t i_;
+            bool isStruct_;
+        }; // json::TapeView::Iterator
+
+        /** Creates undefined view. 
+         */
+        TapeView() = default;
+
+        Value::Kind kind() const {
+            if (tape_ == nullptr)
+                return Value::Kind::Undefined;
+            switch (tape_->tag(i_)) {
+                case Tape::Tag::Null:
+                    return Value::Kind::Null;
+                case Tape::Tag::False:
+                case Tape::Tag::True:
+                    return Value::Kind::Bool;
+                case Tape::Tag::Int:
+                    return Value::Kind::Int;
+                case Tape::Tag::Int64:
+                    return Value::Kind::Int64;
+                case Tape::Tag::UInt64:
+                    return Value::Kind::UInt64;
+                case Tape::Tag::Double:
+                    return Value::Kind::Double;
+                case Tape::Tag::String:
+                    return Value::Kind::String;
+                case Tape::Tag::StartArray:
+                    return Value::Kind::Array;
+                case Tape::Tag::StartStruct:
+                    return Value::Kind::Struct;
+                default:
+                    return Value::Kind::Undefined;
+            }
+        }
+
+        bool asBool() const {
+            if (kind() != Value::Kind::Bool)
+                throw std::invalid_argument{"Expected bool"};
+            return tape_->tag(i_) == Tape::Tag::True;
+        }
+
+        int64_t asInt() const {
+            if (kind() == Value::Kind::Int)
+                return static_cast<int32_t>(tape_->payload(i_));
+            if (kind() != Value::Kind::Int64)
+                throw std::invalid_argument{"Expected integer"};
+            return static_cast<int64_t>(tape_->words_[i_ + 1]);
+        }
+
+        /** Returns the integer that does not fit int64_t. 
+         */
+        uint64_t asUInt() const {
+            if (kind() != Value::Kind::UInt64)
+                throw std::invalid_argument{"Expected unsigned integer"};
+            return tape_->words_[i_ + 1];
+        }
+
+        /** Returns the number as double. Integers are converted. 
+         */
+        double asDouble() const {
+            if (kind() == Value::Kind::UInt64)
+                return static_cast<double>(asUInt());
+            if (kind() != Value::Kind::Double)
+                return static_cast<double>(asInt());
+            double result;
+            std::memcpy(&result, &tape_->words_[i_ + 1], sizeof(result));
+            return result;
+        }
+
+        /** Returns the string. The view is valid as long as the tape. 
+         */
+        std::string_view asString() const {
+            if (kind() != Value::Kind::String)
+                throw std::invalid_argument{"Expected string"};
+            return tape_->string(i_);
+        }
+
+        /** Returns the number of elements of an array or a struct, 0 for other values. 
+         
+            Containers with more than 2^24 - 1 elements have to be counted. 
+         */
+        size_t size() const {
+            if (! isContainer())
+                return 0;
+            size_t result = tape_->payload(i_) >> 32;
+            if (result == Tape::MaxCount) {
+                result = 0;
+                for (auto i = begin(), e = end(); i != e; ++i)
+                    ++result;
+            }
+            return result;
+        }
+
+        /** Returns the i-th element of an array or a struct, or undefined if there is not enough elements. 
+         */
+        TapeView operator [] (size_t i) const {
+            if (i >= size())
+                return TapeView{};
+            auto it = begin();
+            while (i-- > 0)
+                ++it;
+            return *it;
+        }
+
+        /** Returns the field with given name, or undefined if the value is not a struct, or does not have the field. Returns the last field of duplicate names, like the parser.  
+         */
+        TapeView operator [] (std::string_view name) const {
+            TapeView result;
+            if (kind() == Value::Kind::Struct)
+                for (auto i = begin(), e = end(); i != e; ++i)
+                    if (i.key() == name)
+                        result = *i;
+            return result;
+        }
+
+        /** Returns the name of the i-th field of a struct. 
+         */
+        std::string_view key(size_t i) const {
+            if (kind() != Value::Kind::Struct || i >= size())
+                throw std::out_of_range{"Field index out of bounds"};
+            auto it = begin();
+            while (i-- > 0)
+                ++it;
+            return it.key();
+        }
+
+        Iterator begin() const {
+            if (! isContainer())
+                return Iterator{tape_, 0, false};
+            return Iterator{tape_, i_ + 1, kind() == Value::Kind::Struct};
+        }
+
+        Iterator end() const {
+            if (! isContainer())
+                return Iterator{tape_, 0, false};
+            return Iterator{tape_, tape_->payload(i_) & 0xffffffff, kind() == Value::Kind::Struct};
+        }
+
+        /** Materializes the viewed value. 
+         */
+        Value value() const {
+            switch (kind()) {
+                case Value::Kind::Null:
+                    return Null{};
+                case Value::Kind::Bool:
+                    return Value{asBool()};
+                case Value::Kind::Int:
+                    return Value{static_cast<int>(asInt())};
+                case Value::Kind::Int64:
+                    return Value{asInt()};
+                case Value::Kind::UInt64:
+                    return Value{asUInt()};
+                case Value::Kind::Double:
+                    return Value{asDouble()};
+                case Value::Kind::String:
+                    return Value{String{asString()}};
+                case Value::Kind::Array: {
+                    Array result;
+                    for (TapeView element : *this)
+                        result.add(element.value());
+                    return result;
+                }
+                case Value::Kind::Struct: {
+                    Struct result;
+                    for (auto i = begin(), e = end(); i != e; ++i)
+                        result.set(i.key(), (*i).value());
+                    return result;
+                }
+                default:
+                    return Undefined{};
+            }
+        }
+
+    private:
+        friend class Tape;
+
+        TapeView(Tape const * tape, size_t i):
+            tape_{tape},
+            i_{i} {
+        }
+
+        bool isContainer() const {
+            Value::Kind k = kind();
+            return k == Value::Kind::Array || k == Value::Kind::Struct;
+        }
+
+        Tape const * tape_ = nullptr;
+        size_t i_ = 0;
+
+    }; // json::TapeView
+
+    inline TapeView Tape::root() const {
+        if (words_.empty())
+            return TapeView{};
+        return TapeView{this, 0};
+    }
+
+    /** Event handler that builds a Value. 
+     
+        Comments are attached to the value that follows them. Use take() to obtain the value once the whole value has been reported. 
+     */
+    class ValueBuilder {
+    public:
+
+        void onUndefined() { add(Undefined{}); }
+        void onNull() { add(Null{}); }
+        void onBool(bool value) { add(Value{value}); }
+
+        void onInt(int64_t value) {
+            if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max())
+                add(Value{static_cast<int>(value)});
+            else
+                add(Value{value});
+        }
+
+        void onUInt(uint64_t value) { add(Value{value}); }
+        void onDouble(double value) { add(Value{value}); }
+        void onString(std::string_view value) { add(Value{value}); }
+        void onKey(std::string_view name) { keys_.emplace_back(name); }
+        void onStartArray() { open(Array{}); }
+        void onEndArray() { close(); }
+        void onStartStruct() { open(Struct{}); }
+        void onEndStruct() { close(); }
+        void onComment(std::string_view comment) {
+            // consecutive comments are joined by new lines, the same as the parser does
+            if (! comment_.empty())
+                comment_ += '\n';
+            comment_.append(comment);
+        }
+
+        /** Returns the built value and resets the builder.
+         */
+        Value take() {
+            Value result{std::move(result_)};
+            result_ = Undefined{};
+            return result;
+        }
+
+    private:
+
+        void open(Value && container) {
+            if (! comment_.empty()) {
+                container.setComment(comment_);
+                comment_.clear();
+            }
+            stack_.push_back(std::move(container));
+        }
+
+        void close() {
+            Value container{std::move(stack_.back())};
+            stack_.pop_back();
+            add(std::move(container));
+        }
+
+        void add(Value && value) {
+            if (! comment_.empty()) {
+                value.setComment(comment_);
+                comment_.clear();
+            }
+            if (stack_.empty()) {
+                result_ = std::move(value);
+            } else if (stack_.back().kind() == Value::Kind::Array) {
+                stack_.back().valueArray_.add(std::move(value));
+            } else {
+                stack_.back().valueStruct_.set(keys_.back(), std::move(value));
+                keys_.pop_back();
+            }
+        }
+
+        // open containers, deque so that growing does not copy them
+        std::deque<Value> stack_;
+        std::vector<std::string> keys_;
+        std::string comment_;
+        Value result_;
+
+    }; // json::ValueBuilder
+
+    /** Push parser for input that arrives in chunks. 
+     
+        Instead of reading from a blocking stream, the caller feeds the bytes as they arrive and the parser reports the value to the handler (see parse(std::string_view, HANDLER &) for its requirements) as soon as its tokens are complete. All state is kept across the chunk boundaries, so chunks may split the input anywhere, including inside strings, numbers and comments. Only a token split between chunks is copied. By default the value is built with ValueBuilder: 
+
+            json::ChunkedParser<> p;
+            while (! p.done()) {
+                size_t n = socket.read(buffer, sizeof(buffer));
+                p.feed(buffer, n);
+            }
+            json::Value v = p.handler().take();
+
+        A number, or a literal at the top level is only complete when followed by another character, or when finish() is called.  
+     */
+    template<typename HANDLER>
+    class ChunkedParser {
+    public:
+
+        template<typename... ARGS>
+        explicit ChunkedParser(ARGS &&... args):
+            handler_{std::forward<ARGS>(args)...} {
+        }
+
+        HANDLER & handler() { return handler_; }
+
+        /** Returns true if the whole value has been parsed. 
+         */
+        bool done() const { return done_; }
+
+        /** Parses the given chunk. 
+         
+            Stops right after the value is complete and returns the number of bytes consumed, so that any following input can be fed again after reset(). 
+         */
+        size_t feed(char const * data, size_t size) {
+            chunk_ = data;
+            char const * p = data;
+            char const * end = data + size;
+            start_ = data;
+            while (p != end && ! done_) {
+                if (lex_ != Lex::None) {
+                    p = scan(p, end);
+                    if (lex_ != Lex::Done)
+                        break;
+                    lex_ = Lex::None;
+                    token(p);
+                    continue;
+                }
+                char c = *p;
+                if (detail::isWhitespace(c)) {
+                    ++p;
+                    continue;
+                }
+                start_ = p++;
+                switch (c) {
+                    case ':':
+                        grammar(Token{Token::Kind::Colon});
+                        break;
+                    case ',':
+                        grammar(Token{Token::Kind::Comma});
+                        break;
+                    case '[':
+                        grammar(Token{Token::Kind::SquareOpen});
+                        break;
+                    case ']':
+                        grammar(Token{Token::Kind::SquareClose});
+                        break;
+                    case '{':
+                        grammar(Token{Token::Kind::CurlyOpen});
+                        break;
+                    case '}':
+                        grammar(Token{Token::Kind::CurlyClose});
+                        break;
+                    case '"':
+                    case '\'':
+                        quote_ = c;
+                        lex_ = Lex::String;
+                        break;
+                    case '/':
+                        lex_ = Lex::Slash;
+                        break;
+                    default:
+                        if (c == '-' || detail::isDigit(c))
+                            lex_ = Lex::Number;
+                        else if (isIdentifierStart(c))
+                            lex_ = Lex::Identifier;
+                        else
+                            error("Invalid JSON character", start_);
+                }
+            }
+            if (lex_ != Lex::None) {
+                if (carry_.empty())
+                    std::tie(tokenLine_, tokenCol_) = location(start_);
+                carry_.append(start_, p);
+            }
+            std::tie(line_, col_) = location(p);
+            return static_cast<size_t>(p - data);
+        }
+
+        size_t feed(std::string_view chunk) {
+            return feed(chunk.data(), chunk.size());
+        }
+
+        /** Signals the end of input. 
+         
+            Completes a number, or a literal at the end of input and throws if the value is not complete. 
+         */
+        void finish() {
+            chunk_ = nullptr;
+            if (lex_ == Lex::Number || lex_ == Lex::Identifier || lex_ == Lex::LineComment) {
+                start_ = nullptr;
+                token(nullptr);
+            } else if (lex_ != Lex::None) {
+                error(lex_ == Lex::String || lex_ == Lex::StringEscape ? "Unterminated string literal" : "Unterminated multi-line comment", nullptr);
+            }
+            lex_ = Lex::None;
+            if (! done_)
+                error("Unexpected end of input", nullptr);
+        }
+
+        /** Prepares the parser for the next value. The location for errors continues from the previous value.  
+         */
+        void reset() {
+            lex_ = Lex::None;
+            state_ = State::Start;
+            stack_.clear();
+            carry_.clear();
+            done_ = false;
+        }
+
+    private:
+
+        using Token = Value::Parser::Token;
+
+        /** Tokenizer state. 
+         */
+        enum class Lex {
+            None, 
+            String, 
+            StringEscape, 
+            Slash, 
+            LineComment, 
+            BlockComment, 
+            BlockCommentStar, 
+            Number, 
+            Identifier,
+            Done,
+        }; // json::ChunkedParser::Lex
+
+        /** Grammar state. 
+         */
+        enum class State {
+            Start, 
+            AfterOpen, 
+            AfterKey, 
+            AfterColon, 
+            AfterValue, 
+            AfterComma, 
+        }; // json::ChunkedParser::State
+
+        /** Advances over the current multi-character token. Sets lex_ to Done if the token ends before the end of the chunk.  
+         */
+        char const * scan(char const * p, char const * end) {
+            while (p != end) {
+                switch (lex_) {
+                    case Lex::String:
+                        p = detail::findDelimiterOrEscape(p, end, quote_);
+                        if (p == end)
+                            return p;
+                        lex_ = *p++ == quote_ ? Lex::Done : Lex::StringEscape;
+                        break;
+                    case Lex::StringEscape:
+                        ++p;
+                        lex_ = Lex::String;
+                        break;
+                    case Lex::Slash:
+                        if (*p == '/')
+                            lex_ = Lex::LineComment;
+                        else if (*p == '*')
+                            lex_ = Lex::BlockComment;
+                        else
+                            error("Expected // or /* comment", p);
+                        ++p;
+                        break;
+                    case Lex::LineComment: {
+                        auto nl = static_cast<char const *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+                        if (nl == nullptr)
+                            return end;
+                        lex_ = Lex::Done;
+                        return nl + 1;
+                    }
+                    case Lex::BlockComment: {
+                        auto star = static_cast<char const *>(std::memchr(p, '*', static_cast<size_t>(end - p)));
+                        if (star == nullptr)
+                            return end;
+                        p = star + 1;
+                        lex_ = Lex::BlockCommentStar;
+                        break;
+                    }
+                    case Lex::BlockCommentStar:
+                        if (*p == '/')
+                            lex_ = Lex::Done;
+                        else if (*p != '*')
+                            lex_ = Lex::BlockComment;
+                        ++p;
+                        break;
+                    case Lex::Number:
+                        while (p != end && detail::isNumberChar(*p))
+                            ++p;
+                        if (p != end)
+                            lex_ = Lex::Done;
+                        return p;
+                    case Lex::Identifier:
+                        while (p != end && isIdentifier(*p))
+                            ++p;
+                        if (p != end)
+                            lex_ = Lex::Done;
+                        return p;
+                    default:
+                        return p;
+                }
+                if (lex_ == Lex::Done)
+                    return p;
+            }
+            return p;
+        }
+
+        /** Decodes the multi-character token that ends at given position with the regular parser and passes it to the grammar. 
+         */
+        void token(char const * end) {
+            std::string_view raw;
+            if (carry_.empty()) {
+                raw = std::string_view{start_, static_cast<size_t>(end - start_)};
+            } else {
+                carry_.append(start_, end);
+                raw = carry_;
+            }
+            try {
+                Value::Parser p{raw.data(), raw.data() + raw.size()};
+                Token t = p.next();
+                if (p.pos_ != p.end_)
+                    p.error("Invalid number");
+                grammar(t);
+            } catch (Error const & e) {
+                // only the location of the token start is reported 
+                if (carry_.empty())
+                    error(e.what(), start_);
+                throw Error{e.what(), tokenLine_, tokenCol_};
+            }
+            carry_.clear();
+        }
+
+        void grammar(Token const & t) {
+            switch (state_) {
+                case State::Start:
+                case State::AfterColon:
+                    value(t);
+                    return;
+                case State::AfterOpen:
+                case State::AfterComma:
+                    if (t.kind == Token::Kind::Comment) 
+                        handler_.onComment(t.valueString_);
+                    else if (t.kind == Token::Kind::SquareClose || t.kind == Token::Kind::CurlyClose)
+                        close(t);
+                    else if (stack_.back()) 
+                        key(t);
+                    else 
+                        value(t);
+                    return;
+                case State::AfterKey:
+                    if (t.kind == Token::Kind::Comment)
+                        handler_.onComment(t.valueString_);
+                    else if (t.kind == Token::Kind::Colon)
+                        state_ = State::AfterColon;
+                    else
+                        error("Expected colon", start_);
+                    return;
+                case State::AfterValue:
+                    if (t.kind == Token::Kind::Comment)
+                        handler_.onComment(t.valueString_);
+                    else if (t.kind == Token::Kind::Comma)
+                        state_ = State::AfterComma;
+                    else if (t.kind == Token::Kind::SquareClose || t.kind == Token::Kind::CurlyClose)
+                        close(t);
+                    else
+                        error(stack_.back() ? "Expected , or }" : "Expected , or ]", start_);
+                    return;
+            }
+        }
+
+        void value(Token const & t) {
+            switch (t.kind) {
+                case Token::Kind::Comment:
+                    handler_.onComment(t.valueString_);
+                    return;
+                case Token::Kind::Undefined:
+                    handler_.onUndefined();
+                    break;
+                case Token::Kind::Null:
+                    handler_.onNull();
+                    break;
+                case Token::Kind::Bool:
+                    handler_.onBool(t.valueBool_);
+                    break;
+                case Token::Kind::Int:
+                    handler_.onInt(t.valueInt_);
+                    break;
+                case Token::Kind::Int64:
+                    handler_.onInt(t.valueInt64_);
+                    break;
+                case Token::Kind::UInt64:
+                    handler_.onUInt(t.valueUInt64_);
+                    break;
+                case Token::Kind::Double:
+                    handler_.onDouble(t.valueDouble_);
+                    break;
+                case Token::Kind::String:
+                    handler_.onString(t.valueString_);
+                    break;
+                case Token::Kind::SquareOpen:
+                    stack_.push_back(false);
+                    state_ = State::AfterOpen;
+                    handler_.onStartArray();
+                    return;
+                case Token::Kind::CurlyOpen:
+                    stack_.push_back(true);
+                    state_ = State::AfterOpen;
+                    handler_.onStartStruct();
+                    return;
+                default:
+                    error("Expected value", start_);
+            }
+            valueDone();
+        }
+
+        void key(Token const & t) {
+            if (t.kind != Token::Kind::Identifier && t.kind != Token::Kind::String)
+                error("Expected identifier or a string", start_);
+            handler_.onKey(t.valueString_);
+            state_ = State::AfterKey;
+        }
+
+        void close(Token const & t) {
+            bool isStruct = t.kind == Token::Kind::CurlyClose;
+            if (stack_.back() != isStruct)
+                error(stack_.back() ? "Expected , or }" : "Expected , or ]", start_);
+            stack_.pop_back();
+            if (isStruct)
+                handler_.onEndStruct();
+            else
+                handler_.onEndArray();
+            valueDone();
+        }
+
+        void valueDone() {
+            state_ = State::AfterValue;
+            if (stack_.empty())
+                done_ = true;
+        }
+
+        /** Returns the line and column of given position in the current chunk. 
+         */
+        std::pair<size_t, size_t> location(char const * p) const {
+            size_t line = line_;
+            size_t col = col_;
+            for (char const * i = chunk_; i < p; ++i) {
+                if (*i == '\n') {
+                    ++line;
+                    col = 1;
+                } else {
+                    ++col;
+                }
+            }
+            return std::make_pair(line, col);
+        }
+
+        /** Throws error at given position in the current chunk, or at the start of the token that spans chunks if the position is not in the current chunk. 
+         */
+        [[noreturn]] void error(char const * msg, char const * p) {
+            if (p == nullptr || ! carry_.empty()) {
+                if (carry_.empty())
+                    throw Error{msg, line_, col_};
+                throw Error{msg, tokenLine_, tokenCol_};
+            }
+            auto l = location(p);
+            throw Error{msg, l.first, l.second};
+        }
+
+        static bool isIdentifierStart(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+        static bool isIdentifier(char c) { return isIdentifierStart(c) || detail::isDigit(c); } 
+
+        HANDLER handler_;
+
+        Lex lex_ = Lex::None;
+        char quote_ = '"';
+        State state_ = State::Start;
+        // true for structs, false for arrays
+        std::vector<bool> stack_;
+        bool done_ = false;
+
+        // the current chunk and the start of the current token in it
+        char const * chunk_ = nullptr;
+        char const * start_ = nullptr;
+        // beginning of the token that spans chunks
+        std::string carry_;
+
+        // location of the current chunk's beginning and of the token that spans chunks
+        size_t line_ = 1;
+        size_t col_ = 1;
+        size_t tokenLine_ = 1;
+        size_t tokenCol_ = 1;
+
+    }; // json::ChunkedParser
+
+    /** Read-only contents of a file. 
+     
+        On POSIX systems the file is memory mapped for sequential access and unmapped when the object is destroyed. Elsewhere the file is read into memory. Throws std::system_error if the file cannot be opened or read. 
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+
+        explicit MappedFile(std::string const & filename) {
+#if (defined __unix__) || (defined __APPLE__)
+            int fd = ::open(filename.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::system_error{errno, std::generic_category(), filename};
+            struct stat st;
+            if (::fstat(fd, &st) != 0) {
+                int err = errno;
+                ::close(fd);
+                throw std::system_error{err, std::generic_category(), filename};
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ > 0) {
+                void * addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr == MAP_FAILED) {
+                    int err = errno;
+                    ::close(fd);
+                    throw std::system_error{err, std::generic_category(), filename};
+                }
+#if (defined MADV_SEQUENTIAL)
+                ::madvise(addr, size_, MADV_SEQUENTIAL);
+#endif
+                data_ = static_cast<char const *>(addr);
+                mapped_ = true;
+            }
+            ::close(fd);
+#else
+            std::ifstream f{filename, std::ios::binary | std::ios::ate};
+            if (! f.good())
+                throw std::system_error{errno, std::generic_category(), filename};
+            size_ = static_cast<size_t>(f.tellg());
+            buffer_.reset(new char[size_]);
+            f.seekg(0);
+            if (! f.read(buffer_.get(), static_cast<std::streamsize>(size_)))
+                throw std::system_error{errno, std::generic_category(), filename};
+            data_ = buffer_.get();
+#endif
+        }
+
+        MappedFile(MappedFile && from) noexcept:
+            data_{from.data_},
+            size_{from.size_},
+            mapped_{from.mapped_},
+            buffer_{std::move(from.buffer_)} {
+            from.data_ = nullptr;
+            from.size_ = 0;
+            from.mapped_ = false;
+        }
+
+        MappedFile(MappedFile const &) = delete;
+
+        ~MappedFile() {
+            unmap();
+        }
+
+        MappedFile & operator = (MappedFile && from) noexcept {
+            if (this != &from) {
+                unmap();
+                data_ = from.data_;
+                size_ = from.size_;
+                mapped_ = from.mapped_;
+                buffer_ = std::move(from.buffer_);
+                from.data_ = nullptr;
+                from.size_ = 0;
+                from.mapped_ = false;
+            }
+            return *this;
+        }
+
+        MappedFile & operator = (MappedFile const &) = delete;
+
+        char const * data() const { return data_; }
+        size_t size() const { return size_; }
+        std::string_view view() const { return std::string_view{data_, size_}; }
+
+    private:
+
+        void unmap() {
+#if (defined __unix__) || (defined __APPLE__)
+            if (mapped_)
+                ::munmap(const_cast<char *>(data_), size_);
+#endif
+            mapped_ = false;
+        }
+
+        char const * data_ = nullptr;
+        size_t size_ = 0;
+        bool mapped_ = false;
+        std::unique_ptr<char[]> buffer_;
+
+    }; // json::MappedFile
+
+    /** Parses the given file and returns the JSON object. 
+     
+        The file is mapped into memory and parsed directly from the mapping, which is released when parsing completes. 
+     */
+    inline Value parseFile(std::string const & filename) {
+        MappedFile f{filename};
+        return parse(f.view());
+    }
+
+    /** Parses the given string interning the struct field names in the given key table. 
+     
+        The table must outlive the returned value, but not its copies. 
+     */
+    inline Value parse(std::string_view str, KeyTable & keys) {
+        Value::Parser p{str.data(), str.data() + str.size()};
+        p.internKeys(&keys);
+        return p.parse();
+    }
+
+    /** Parses the given string without copying strings that have no escape sequences. 
+     
+        Such strings in the returned value borrow their characters from the input, which must outlive them. Copying a value makes the copy own all its strings. 
+     */
+    inline Value parseInSitu(std::string_view str) {
+        Value::Parser p{str.data(), str.data() + str.size(), true};
+        return p.parse();
+    }
+
+    /** Parsed JSON document that owns its input. 
+     
+        Strings in the document borrow their characters from the input buffer, which the document keeps alive, so that most strings require no allocation at all. All arrays, structs and the remaining strings are bump allocated from the document's arena, which is released at once when the document is destroyed. The document can be moved, but its root value or its parts must not outlive it unless copied. 
+     */
+    class Document {
+    public:
+
+        /** Parses the given string. 
+         */
+        static Document parse(std::string input) {
+            Document result;
+            result.input_.reset(new std::string{std::move(input)});
+            result.parseInput(*result.input_);
+            return result;
+        }
+
+        /** Memory maps the given file and parses it, keeping the mapping alive for as long as the document exists. 
+         */
+        static Document parseFile(std::string const & filename) {
+            Document result;
+            result.file_ = MappedFile{filename};
+            result.parseInput(result.file_.view());
+            return result;
+        }
+
+        Document(Document &&) = default;
+
+        /** Replaces the document with another one. 
+         
+            The implicit move assignment would release the old arena and input before the old root that refers to them. 
+         */
+        Document & operator = (Document && other) {
+            if (this != &other) {
+                root_ = Value{};
+                input_ = std::move(other.input_);
+                file_ = std::move(other.file_);
+                arena_ = std::move(other.arena_);
+                root_ = std::move(other.root_);
+            }
+            return *this;
+        }
+
+        Value const & root() const { return root_; }
+        Value & root() { return root_; }
+
+    private:
+        Document() = default;
+
+        void parseInput(std::string_view input) {
+            // the input size is a reasonable first guess of the memory needed, the arena grows geometrically 
+            arena_.reset(new std::pmr::monotonic_buffer_resource{std::max(input.size(), ArenaMinBlockSize)});
+            Value::Parser p{input.data(), input.data() + input.size(), true, arena_.get()};
+            root_ = p.parse();
+        }
+
+        static constexpr size_t ArenaMinBlockSize = 4096;
+
+        std::unique_ptr<std::string> input_;
+        MappedFile file_;
+        std::unique_ptr<std::pmr::monotonic_buffer_resource> arena_;
+        // must be declared last so that it is destroyed before the input and the arena
+        Value root_;
+    }; // json::Document
+
+    namespace detail {
+
+        /** Writes the digits of the unsigned integer backwards, ending just before the given pointer, and returns pointer to the first character written. At most 20 characters are written. 
+         
+            Two digits are produced per division using a table of all digit pairs, which halves the number of the rather slow divisions.  
+         */
+        inline char * formatUInt(char * end, uint64_t x) {
+            static constexpr char digitPairs[] = 
+                "0001020304050607080910111213141516171819"
+                "2021222324252627282930313233343536373839"
+                "4041424344454647484950515253545556575859"
+                "6061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+            while (x >= 100) {
+                size_t i = static_cast<size_t>(x % 100) * 2;
+                x /= 100;
+                *--end = digitPairs[i + 1];
+                *--end = digitPairs[i];
+            }
+            if (x >= 10) {
+                size_t i = static_cast<size_t>(x) * 2;
+                *--end = digitPairs[i + 1];
+                *--end = digitPairs[i];
+            } else {
+                *--end = static_cast<char>('0' + x);
+            }
+            return end;
+        }
+
+        /** Writes the digits of the integer backwards, preceded by the sign if negative, like formatUInt(). At most 20 characters are written. 
+         */
+        inline char * formatInt(char * end, int64_t value) {
+            // negate in unsigned so that the minimum value does not overflow
+            end = formatUInt(end, value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value));
+            if (value < 0)
+                *--end = '-';
+            return end;
+        }
+
+        /** Writes the shortest representation of the double that parses back to the same value into the buffer, which must have space for at least 32 characters, and returns the number of characters written. 
+         
+            Integral values that fit in 53 bits are formatted as integers directly. Other values use std::to_chars where the standard library supports it for floating point values, which produces the shortest round trip representation (and is an implementation of Ryu in both libstdc++ and MSVC), and fall back to 17 significant digits, which round trip but are not always the shortest, otherwise. Finite values that would look like integers get ".0" appended so that they are parsed back as doubles. JSON has no representation of NaN and infinities, so they are written as null.  
+         */
+        inline size_t formatDouble(char * buffer, double value) {
+            if (! std::isfinite(value)) {
+                std::memcpy(buffer, "null", 4);
+                return 4;
+            }
+            char * end;
+            if (value == std::trunc(value) && std::abs(value) < 9007199254740992.0) {
+                // negative zero is not integral for our purposes
+                if (value == 0 && std::signbit(value)) {
+                    std::memcpy(buffer, "-0.0", 4);
+                    return 4;
+                }
+                char digits[20];
+                char * i = formatInt(digits + sizeof(digits), static_cast<int64_t>(value));
+                end = std::copy(i, digits + sizeof(digits), buffer);
+            } else {
+#if (defined __cpp_lib_to_chars)
+                end = std::to_chars(buffer, buffer + 32, value).ptr;
+#else
+                end = buffer + std::snprintf(buffer, 32, "%.17g", value);
+#endif
+            }
+            if (std::find_if(buffer, end, [](char c) { return c == '.' || c == 'e' || c == 'E'; }) == end) {
+                *end++ = '.';
+                *end++ = '0';
+            }
+            return static_cast<size_t>(end - buffer);
+        }
+
+    } // namespace json::detail
+
+    /** Serializes values into a contiguous buffer. 
+     
+        All values are formatted by hand directly into the buffer, without going through std::ostream and its locale-aware formatting. By default the output is accumulated in the buffer until taken: 
+
+            json::Serializer s;
+            s << value;
+            send(s.view());
+
+        Alternatively a sink can be given, in which case the buffer is passed to the sink every time it fills up, when flush() is called, and when the serializer is destroyed, so that large values can be serialized in constant memory. 
+        
+        By default the output is compact, with ", " between elements and " : " between keys and values, same as operator <<, which uses the serializer as well. The Format can instead specify pretty printing with indentation, sorted keys and comments: 
+
+            json::Serializer s{sink, json::Serializer::Format{2, 80, true, true}};
+            s << config;
+
+        Comments are written before the values they are attached to, which is where the parser reads them from, so that values with comments round trip. 
+     */
+    class Serializer {
+    public:
+        using Sink = std::function<void(char const *, size_t)>;
+
+        static constexpr size_t DefaultBufferSize = 16384;
+
+        /** Output format. 
+         */
+        struct Format {
+            /** Number of spaces per nesting level. When 0, the output is a single line.
+             */
+            size_t indent = 0;
+            /** When indenting, arrays and structs whose single line form fits in this many characters are not broken into lines. 
+             */
+            size_t inlineWidth = 0;
+            /** Writes struct fields sorted by their names instead of in their order. 
+             */
+            bool sortKeys = false;
+            /** Writes comments attached to the values. 
+             */
+            bool comments = false;
+        }; // json::Serializer::Format
+
+        /** Creates serializer that accumulates the output in its buffer. 
+         */
+        Serializer() = default;
+
+        explicit Serializer(Format const & format):
+            format_{format} {
+        }
+
+        /** Creates serializer that passes the output to the given sink in chunks of the given size. 
+         */
+        explicit Serializer(Sink sink, size_t bufferSize = DefaultBufferSize):
+            sink_{std::move(sink)},
+            bufferSize_{bufferSize} {
+        }
+
+        Serializer(Sink sink, Format const & format, size_t bufferSize = DefaultBufferSize):
+            sink_{std::move(sink)},
+            format_{format},
+            bufferSize_{bufferSize} {
+        }
+
+        /** Creates serializer that writes to the given stream. 
+         */
+        explicit Serializer(std::ostream & s, size_t bufferSize = DefaultBufferSize):
+            Serializer{s, Format{}, bufferSize} {
+        }
+
+        Serializer(std::ostream & s, Format const & format, size_t bufferSize = DefaultBufferSize):
+            Serializer{[&s](char const * data, size_t size) { s.write(data, static_cast<std::streamsize>(size)); }, format, bufferSize} {
+        }
+
+        Serializer(Serializer const &) = delete;
+        Serializer & operator = (Serializer const &) = delete;
+
+        /** Flushes any remaining output to the sink. Errors are ignored, call flush() to get them. 
+         */
+        ~Serializer() {
+            try {
+                flush();
+            } catch (...) {
+            }
+        }
+
+        /** Passes the buffered output to the sink, if any. 
+         */
+        void flush() {
+            if (sink_ && ! buffer_.empty()) {
+                sink_(buffer_.data(), buffer_.size());
+                buffer_.clear();
+            }
+        }
+
+        /** Returns the buffered output. 
+         */
+        std::string_view view() const { return buffer_; }
+
+        /** Returns the buffered output and clears the buffer. 
+         */
+        std::string take() {
+            std::string result;
+            std::swap(result, buffer_);
+            return result;
+        }
+
+        void clear() { buffer_.clear(); }
+
+#if (defined __unix__) || (defined __APPLE__)
+        /** Returns sink that writes to the given file descriptor. Throws std::system_error if the write fails. 
+         */
+        static Sink fileSink(int fd) {
+            return [fd](char const * data, size_t size) {
+                while (size > 0) {
+                    ssize_t written = ::write(fd, data, size);
+                    if (written < 0) {
+                        if (errno == EINTR)
+                            continue;
+                        throw std::system_error{errno, std::generic_category(), "write"};
+                    }
+                    data += written;
+                    size -= static_cast<size_t>(written);
+                }
+            };
+        }
+#endif
+
+        Serializer & operator << (Value const & value) { write(value); return *this; }
+        Serializer & operator << (Undefined const & value) { writeComment(value.comment()); write(value); return *this; }
+        Serializer & operator << (Null const & value) { writeComment(value.comment()); write(value); return *this; }
+        Serializer & operator << (Bool const & value) { writeComment(value.comment()); write(value); return *this; }
+        Serializer & operator << (Int const & value) { writeComment(value.comment()); write(value); return *this; }
+        Serializer & operator << (Int64 const & value) { writeComment(value.comment()); write(value); return *this; }
+        Serializer & operator << (UInt64 const & value) { writeComment(value.comment()); write(value); return *this; }
+        Serializer & operator << (Double const & value) { writeComment(value.comment()); write(value); return *this; }
+        Serializer & operator << (String const & value) { writeComment(value.comment()); write(value); return *this; }
+        Serializer & operator << (Array const & value) { writeComment(value.comment()); write(value); return *this; }
+        Serializer & operator << (Struct const & value) { writeComment(value.comment()); write(value); return *this; }
+
+    private:
+        friend class Writer;
+
+        /** Writes the value preceded by its comment. 
+         */
+        void write(Value const & value) {
+            writeComment(value.comment());
+            switch (value.kind()) {
+                case Value::Kind::Undefined:
+                    return write(Undefined{});
+                case Value::Kind::Null:
+                    return write(Null{});
+                case Value::Kind::Bool:
+                    return write(value.as<Bool>());
+                case Value::Kind::Int:
+                    return write(value.as<Int>());
+                case Value::Kind::Int64:
+                    return write(value.as<Int64>());
+                case Value::Kind::UInt64:
+                    return write(value.as<UInt64>());
+                case Value::Kind::Double:
+                    return write(value.as<Double>());
+                case Value::Kind::String:
+                    return write(value.as<String>());
+                case Value::Kind::Array:
+                    return write(value.as<Array>());
+                case Value::Kind::Struct:
+                    return write(value.as<Struct>());
+            }
+        }
+
+        void write(Undefined const &) { append("undefined", 9); }
+        void write(Null const &) { append("null", 4); }
+
+        void write(Bool const & value) {
+            if (value)
+                append("true", 4);
+            else
+                append("false", 5);
+        }
+
+        void write(Int const & value) { writeInt(static_cast<int>(value)); }
+        void write(Int64 const & value) { writeInt(static_cast<int64_t>(value)); }
+        void write(UInt64 const & value) { writeUInt(static_cast<uint64_t>(value)); }
+        void write(Double const & value) { writeDouble(static_cast<double>(value)); }
+        void write(String const & value) { writeString(value.view()); }
+
+        void write(Array const & value) {
+            if (value.size() == 0) {
+                append("[]", 2);
+                return;
+            }
+            bool lines = breakLines(value);
+            append('[');
+            ++depth_;
+            for (auto i = value.begin(), e = value.end(); i != e; ++i) {
+                if (i != value.begin())
+                    append(lines ? "," : ", ", lines ? 1 : 2);
+                if (lines)
+                    newline();
+                write(*i);
+            }
+            --depth_;
+            if (lines)
+                newline();
+            append(']');
+        }
+
+        void write(Struct const & value) {
+            if (value.size() == 0) {
+                append("{}", 2);
+                return;
+            }
+            bool lines = breakLines(value);
+            std::vector<size_t> order;
+            if (format_.sortKeys) {
+                order.resize(value.size());
+                for (size_t i = 0; i < order.size(); ++i)
+                    order[i] = i;
+                std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return value.key(a) < value.key(b); });
+            }
+            append('{');
+            ++depth_;
+            for (size_t i = 0, e = value.size(); i != e; ++i) {
+                if (i != 0)
+                    append(lines ? "," : ", ", lines ? 1 : 2);
+                if (lines)
+                    newline();
+                size_t field = order.empty() ? i : order[i];
+                writeString(value.key(field));
+                append(" : ", 3);
+                write(value[field]);
+            }
+            --depth_;
+            if (lines)
+                newline();
+            append('}');
+        }
+
+        /** Determines whether the container's elements should be written on separate lines, which is when indenting and the container does not fit in the inline width. 
+         */
+        template<typename T>
+        bool breakLines(T const & container) {
+            if (format_.indent == 0)
+                return false;
+            size_t width = 0;
+            return ! measure(container, width);
+        }
+
+        /** Adds the single line width of the value to width and returns true if it still fits in the inline width. 
+         
+            Stops as soon as the width is exceeded, so that measuring takes at most time proportional to the inline width. Values with line comments never fit. 
+         */
+        bool measure(Value const & value, size_t & width) {
+            if (! measureComment(value.comment(), width))
+                return false;
+            char buffer[32];
+            switch (value.kind()) {
+                case Value::Kind::Undefined:
+                    width += 9;
+                    break;
+                case Value::Kind::Null:
+                    width += 4;
+                    break;
+                case Value::Kind::Bool:
+                    width += value.as<Bool>() ? 4 : 5;
+                    break;
+                case Value::Kind::Int:
+                    width += static_cast<size_t>(buffer + sizeof(buffer) - detail::formatInt(buffer + sizeof(buffer), static_cast<int>(value.as<Int>())));
+                    break;
+                case Value::Kind::Int64:
+                    width += static_cast<size_t>(buffer + sizeof(buffer) - detail::formatInt(buffer + sizeof(buffer), static_cast<int64_t>(value.as<Int64>())));
+                    break;
+                case Value::Kind::UInt64:
+                    width += static_cast<size_t>(buffer + sizeof(buffer) - detail::formatUInt(buffer + sizeof(buffer), static_cast<uint64_t>(value.as<UInt64>())));
+                    break;
+                case Value::Kind::Double:
+                    width += detail::formatDouble(buffer, static_cast<double>(value.as<Double>()));
+                    break;
+                case Value::Kind::String:
+                    return measureString(value.as<String>().view(), width);
+                case Value::Kind::Array:
+                    return measure(value.as<Array>(), width);
+                case Value::Kind::Struct:
+                    return measure(value.as<Struct>(), width);
+            }
+            return width <= format_.inlineWidth;
+        }
 
+        bool measure(Array const & value, size_t & width) {
+            width += 2;
+            for (auto i = value.begin(), e = value.end(); i != e; ++i) {
+                if (i != value.begin())
+                    width += 2;
+                if (width > format_.inlineWidth || ! measure(*i, width))
+                    return false;
+            }
+            return width <= format_.inlineWidth;
+        }
 
+        bool measure(Struct const & value, size_t & width) {
+            width += 2;
+            for (size_t i = 0, e = value.size(); i != e; ++i) {
+                width += i == 0 ? 3 : 5;
+                if (! measureString(value.key(i), width) || ! measure(value[i], width))
+                    return false;
             }
+            return width <= format_.inlineWidth;
         }
 
-        void addStructField(Struct & s, Token const & t) {
-            if (t.kind != Token::Kind::Identifier && t.kind != Token::Kind::String)
-                throw "Expected identifier or a string";
-            std::string fieldName = t.valueString_;
-            if (next().kind != Token::Kind::Colon)
-                throw "Expected colon";
-            s.set(fieldName, parse(next()));
+        bool measureString(std::string_view value, size_t & width) {
+            width += value.size() + 2;
+            char const * p = value.data();
+            char const * end = p + value.size();
+            while (width <= format_.inlineWidth && (p = detail::findEscape(p, end)) != end) {
+                unsigned char c = static_cast<unsigned char>(*p++);
+                width += (c < 0x20 && c != '\n' && c != '\t' && c != '\r' && c != '\b' && c != '\f') ? 5 : 1;
+            }
+            return width <= format_.inlineWidth;
         }
 
-        Value parseWithComment(std::string comment) {
-            Value result = parse();
-            result.setComment(comment);
-            return result;
+        bool measureComment(std::string const & comment, size_t & width) {
+            if (! format_.comments || comment.empty())
+                return true;
+            if (isLineComment(comment))
+                return false;
+            width += comment.size() + 5;
+            return width <= format_.inlineWidth;
         }
 
-        /** Returns the next token in the input stream. 
-         
-            " => string
-            0-9 => number 
-            a-zA-Z_ => identifier
-            / => comment
+        /** Comments that contain the end of a block comment must be written as line comments. 
+         */
+        static bool isLineComment(std::string_view comment) {
+            return comment.find("*/") != std::string_view::npos;
+        }
 
-            */
-        Token next() {
+        /** Writes the comment, if enabled, as a block comment followed by a space, or as line comments when it cannot be a block comment. The parser joins consecutive line comments by new lines, so either form round trips. 
+         */
+        void writeComment(std::string const & comment) {
+            if (! format_.comments || comment.empty())
+                return;
+            if (! isLineComment(comment)) {
+                append("/*", 2);
+                append(comment.data(), comment.size());
+                append("*/ ", 3);
+                return;
+            }
+            std::string_view rest{comment};
             while (true) {
-                auto line = l_;
-                auto col = c_;
-                auto c = nextChar();
-                switch (c) {
-                    case ':':
-                        return Token{l_, c_, Token::Kind::Colon};
-                    case ',':
-                        return Token{l_, c_, Token::Kind::Comma};
-                    case '[':
-                        return Token{l_, c_, Token::Kind::SquareOpen};
-                    case ']':
-                        return Token{l_, c_, Token::Kind::SquareClose};
-                    case '{':
-                        return Token{l_, c_, Token::Kind::CurlyOpen};
-                    case '}':
-                        return Token{l_, c_, Token::Kind::CurlyClose};
-                    case '/':
-                        return Token{l_, c_, Token::Kind::Comment, nextComment(l_, c_)};
-                    case '"':
-                    case '\'':
-                        return Token{l_, c_, Token::Kind::String, nextString(l_, c_, c)};
-                    case '-':
-                        return nextNumber(l_, c_, c);
-                    case ' ':
-                    case '\t':
-                    case '\n':
-                    case '\r':
-                        // whitespace, just read next
-                        break;
-                    default:
-                        if (isDigit(c))
-                            return nextNumber(l_, c_, c);
-                        else if (isIdentifierStart(c))
-                            return nextIdentifier(l_, c_, c);
-                        else
-                            error("Valid JSON character");
-                }
+                size_t eol = rest.find('\n');
+                append("//", 2);
+                append(rest.data(), std::min(eol, rest.size()));
+                newline();
+                if (eol == std::string_view::npos)
+                    break;
+                rest = rest.substr(eol + 1);
             }
         }
 
-        std::string nextComment(size_t l, size_t c) {
-            std::string result{};
-            switch (nextChar()) {
-                case '/': // single line comment
-                    while (! eof()) {
-                        char c = nextChar();
-                        if (c == '\n')
-                            break;
-                        result += c;
-                    }
-                    break;
-                case '*': // multi-line comment 
-                    while (true) {
-                        if (eof())
-                            error(l, c, "Unterminated multi-line comment");
-                        char c = nextChar();
-                        if (c == '*') {
-                            char c2 = nextChar();
-                            if (c2 == '/')
-                                break;
-                            result += c;
-                            result += c2;
-                        } else {
-                            result += c;
-                        }
-                    }
-                    break;
-                default:
-                    error("// or /* comment");
+        void newline() {
+            static constexpr char spaces[] = "                                                                ";
+            append('\n');
+            size_t n = depth_ * format_.indent;
+            while (n > 0) {
+                size_t chunk = std::min(n, sizeof(spaces) - 1);
+                append(spaces, chunk);
+                n -= chunk;
             }
-            return result;
         }
 
-        std::string nextString(size_t l, size_t c, char delimiter) {
-            std::string result{};
+        void append(char c) {
+            buffer_.push_back(c);
+            if (buffer_.size() >= bufferSize_)
+                flush();
+        }
+
+        void append(char const * data, size_t size) {
+            buffer_.append(data, size);
+            if (buffer_.size() >= bufferSize_)
+                flush();
+        }
+
+        void writeInt(int64_t value) {
+            char buffer[20];
+            char * end = buffer + sizeof(buffer);
+            char * i = detail::formatInt(end, value);
+            append(i, static_cast<size_t>(end - i));
+        }
+
+        void writeUInt(uint64_t value) {
+            char buffer[20];
+            char * end = buffer + sizeof(buffer);
+            char * i = detail::formatUInt(end, value);
+            append(i, static_cast<size_t>(end - i));
+        }
+
+        void writeDouble(double value) {
+            char buffer[32];
+            size_t size = detail::formatDouble(buffer, value);
+            append(buffer, size);
+        }
+
+        /** Writes the string in quotes, escaping where necessary. 
+         
+            Runs of characters that need no escaping, which is usually the whole string, are found with SIMD and copied at once.  
+         */
+        void writeString(std::string_view value) {
+            append('"');
+            char const * p = value.data();
+            char const * end = p + value.size();
             while (true) {
-                if (eof())
-                    error(l, c, "unterminated string literal");
-                char c = nextChar();
-                if (c == delimiter) {
+                char const * run = p;
+                p = detail::findEscape(p, end);
+                append(run, static_cast<size_t>(p - run));
+                if (p == end)
                     break;
-                } else if (c == '\\') { 
-                    char c = nextChar();
-                    switch (c) {
-                        case '"':
-                        case '\'':
-                        case '\\':
-                            result += c;
-                            break;
-                        case 't':
-                            result += '\t';
-                            break;
-                        case 'n':
-                            result += '\n';
-                            break;
-                        case 'r':
-                            result += '\r';
-                            break;
-                        case '\n':
-                            break;
-                        default:
-                            error("valid string escape sequence");
-                    }
-                } else {
-                    result += c;
+                writeEscape(*p++);
+            }
+            append('"');
+        }
+
+        void writeEscape(char c) {
+            switch (c) {
+                case '"':
+                    append("\\\"", 2);
+                    break;
+                case '\\':
+                    append("\\\\", 2);
+                    break;
+                case '\n':
+                    append("\\n", 2);
+                    break;
+                case '\t':
+                    append("\\t", 2);
+                    break;
+                case '\r':
+                    append("\\r", 2);
+                    break;
+                case '\b':
+                    append("\\b", 2);
+                    break;
+                case '\f':
+                    append("\\f", 2);
+                    break;
+                default: {
+                    static constexpr char hex[] = "0123456789abcdef";
+                    char escape[] = { '\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf] };
+                    append(escape, sizeof(escape));
                 }
             }
-            return result;
         }
 
-        /** Parses an identifier. 
+        Sink sink_;
+        Format format_;
+        // output accumulated in the buffer is never flushed without a sink
+        size_t bufferSize_ = std::numeric_limits<size_t>::max();
+        std::string buffer_;
+        // nesting level for indentation
+        size_t depth_ = 0;
+
+    }; // json::Serializer
+
+    /** Push-style writer that emits JSON without building a Value. 
+     
+        The output goes to a serializer, so it is either accumulated in a buffer, or passed to a sink, such as a file descriptor, in chunks: 
+
+            json::Writer w{json::Serializer::fileSink(fd)};
+            w.beginStruct();
+            w.key("id");
+            w.value(id);
+            w.key("tags");
+            w.beginArray();
+            for (auto & tag : tags)
+                w.value(tag);
+            w.endArray();
+            w.endStruct();
+
+        The output is compact and has the same format as the serializer's. Separators are inserted automatically. In debug builds the writer asserts that keys are only written in structs, that every struct value has a key and that containers are closed in the right order.   
+     */
+    class Writer {
+    public:
+        /** Creates writer that accumulates the output in its buffer. 
          */
-        Token nextIdentifier(size_t l, size_t c, char start) {
-            std::string result{start};
-            while (! eof() && isIdentifier(peekChar()))
-                result += nextChar();
-            if (result == "null")
-                return Token{l, c, Token::Kind::Null};
-            else if (result == "undefined")
-                return Token{l, c, Token::Kind::Undefined};
-            else if (result == "true")
-                return Token{l, c, Token::Kind::Bool, true};
-            else if (result == "false")
-                return Token{l, c, Token::Kind::Bool, false};
-            else
-                return Token{l, c, Token::Kind::Identifier, std::move(result)};
-        }
+        Writer() = default;
 
-        Token nextNumber(size_t l, size_t c, char start) {
-            bool neg = false;
-            while (start == '-') {
-                neg = ! neg;
-                start = nextChar();
-            }
-            if (! isDigit(start))
-                error("invalid number character");
-            int result = (start - '0');
-            while (isDigit(peekChar()))
-                result = result * 10 + (nextChar() - '0');
-            if (peekChar() == '.') {
-                nextChar();
-                double dresult = result;
-                double div = 10.0;
-                while (isDigit(peekChar())) {
-                    dresult += (nextChar() - '0') / div;
-                    div *= 10;
-                }
-                return Token{l, c, Token::Kind::Double, neg ? -dresult : dresult};
-            } else {
-                return Token{l, c, Token::Kind::Int, neg ? -result : result};
-            }
+        /** Creates writer that passes the output to the given sink in chunks of the given size. 
+         */
+        explicit Writer(Serializer::Sink sink, size_t bufferSize = Serializer::DefaultBufferSize):
+            out_{std::move(sink), bufferSize} {
         }
 
-        char nextChar() {
-            char result = s_.get();
-            if (result == '\r') {
-                ++l_;
-                c_ = 1;
-            } else {
-                ++c_;
-            }
-            return result;
+        void beginArray() {
+            beginValue();
+            out_.append('[');
+            open(false);
         }
 
-        char peekChar() {
-            return s_.peek();
+        void endArray() {
+            close(false);
+            out_.append(']');
         }
 
-        bool eof() {
-            return s_.eof();
+        void beginStruct() {
+            beginValue();
+            out_.append('{');
+            open(true);
         }
 
-        void error(char const * expected) {
-            // TODO
+        void endStruct() {
+            close(true);
+            out_.append('}');
         }
-        void error(size_t l, size_t c, char const * msg) {
-            // TODO
+
+        void key(std::string_view name) {
+            assert(! stack_.empty() && stack_.back() && ! afterKey_ && "Key must be in a struct and followed by a value");
+            if (separator_)
+                out_.append(", ", 2);
+            out_.writeString(name);
+            out_.append(" : ", 3);
+            separator_ = false;
+#if (! defined NDEBUG)
+            afterKey_ = true;
+#endif
         }
 
-        bool isDigit(char c) { return c > '0' && c <= '9'; }
-        bool isIdentifierStart(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
-        bool isIdentifier(char c) { return isIdentifierStart(c) || isDigit(c); } 
+        void null() { beginValue(); out_.append("null", 4); }
+        void value(bool value) { beginValue(); out_.write(Bool{value}); }
+        void value(int value) { beginValue(); out_.writeInt(value); }
+        void value(int64_t value) { beginValue(); out_.writeInt(value); }
+        void value(uint64_t value) { beginValue(); out_.writeUInt(value); }
+        void value(double value) { beginValue(); out_.writeDouble(value); }
+        void value(std::string_view value) { beginValue(); out_.writeString(value); }
+        void value(char const * value) { beginValue(); out_.writeString(value); }
 
-        // location information for better errors
-        size_t l_ = 1;
-        size_t c_ = 1;
+        /** Writes the whole value. 
+         */
+        void value(Value const & value) { beginValue(); out_.write(value); }
 
-        std::istream & s_;
+        /** Passes the buffered output to the sink, if any. 
+         */
+        void flush() { out_.flush(); }
 
-    }; // json::Value::Parser
+        /** Returns the buffered output. 
+         */
+        std::string_view view() const { return out_.view(); }
 
-    /** Parses the given stream and returns the JSON object. 
-     */
-    inline Value parse(std::istream & s) {
-        Value::Parser p{s};
-        return p.parse();
-    }
+        /** Returns the buffered output and clears the buffer. 
+         */
+        std::string take() { return out_.take(); }
 
-    /** Parses the given string and returns the JSON object. 
-     */
-    inline Value parse(char const * str) {
-        std::stringstream s{str};
-        return parse(s);
-    }
+    private:
 
+        /** Writes the separator, if any, before a value. 
+         */
+        void beginValue() {
+            assert((stack_.empty() || ! stack_.back() || afterKey_) && "Struct values must be preceded by a key");
+            if (separator_)
+                out_.append(", ", 2);
+            separator_ = true;
+#if (! defined NDEBUG)
+            afterKey_ = false;
+#endif
+        }
+
+        void open(bool isStruct) {
+            separator_ = false;
+#if (! defined NDEBUG)
+            stack_.push_back(isStruct);
+#else
+            UNUSED(isStruct);
+#endif
+        }
+
+        void close(bool isStruct) {
+            assert(! stack_.empty() && stack_.back() == isStruct && ! afterKey_ && "Mismatched end of array or struct");
+            separator_ = true;
+#if (! defined NDEBUG)
+            stack_.pop_back();
+#else
+            UNUSED(isStruct);
+#endif
+        }
+
+        Serializer out_;
+        // true if a separator must be written before the next key or value
+        bool separator_ = false;
+#if (! defined NDEBUG)
+        // open containers, true for structs, and whether a key has been written without its value, only tracked for the assertions
+        std::vector<bool> stack_;
+        bool afterKey_ = false;
+#endif
+
+    }; // json::Writer
 
-    // TODO serialize
+    inline std::ostream & operator << (std::ostream & s, Undefined const & json) { Serializer{s} << json; return s; }
+    inline std::ostream & operator << (std::ostream & s, Null const & json) { Serializer{s} << json; return s; }
+    inline std::ostream & operator << (std::ostream & s, Bool const & json) { Serializer{s} << json; return s; }
+    inline std::ostream & operator << (std::ostream & s, Int const & json) { Serializer{s} << json; return s; }
+    inline std::ostream & operator << (std::ostream & s, Int64 const & json) { Serializer{s} << json; return s; }
+    inline std::ostream & operator << (std::ostream & s, UInt64 const & json) { Serializer{s} << json; return s; }
+    inline std::ostream & operator << (std::ostream & s, Double const & json) { Serializer{s} << json; return s; }
+    inline std::ostream & operator << (std::ostream & s, String const & json) { Serializer{s} << json; return s; }
+    inline std::ostream & operator << (std::ostream & s, Array const & json) { Serializer{s} << json; return s; }
+    inline std::ostream & operator << (std::ostream & s, Struct const & json) { Serializer{s} << json; return s; }
+    inline std::ostream & operator << (std::ostream & s, Value const & json) { Serializer{s} << json; return s; }
 
 
 
@@ -1177,6 +5187,17 @@ TEST(json, Array) {
     x.add(json::Null{});
     x.add(json::Undefined{});
     EXPECT_EQ(STR(x), "[4, 5.6, true, false, \"foo\", null, undefined]");
+    EXPECT_EQ(x.size(), 7u);
+    EXPECT_EQ(&x[1], x.begin() + 1);
+    EXPECT_EQ(x[4], json::String{"foo"});
+    json::Array y{x};
+    EXPECT(y == x);
+    y[0] = 5;
+    EXPECT(y != x);
+    size_t n = 0;
+    for (json::Value const & v : y)
+        n += v == json::Null{} ? 1 : 0;
+    EXPECT_EQ(n, 1u);
 }
 
 TEST(json, Struct) {
@@ -1186,6 +5207,24 @@ TEST(json, Struct) {
     EXPECT_EQ(STR(x), "{\"foo\" : \"bar\", \"bar\" : true}");
     EXPECT_EQ(x["zaza"], json::undefined);
     EXPECT_EQ(STR(x), "{\"foo\" : \"bar\", \"bar\" : true, \"zaza\" : undefined}");
+    // crossing the small struct threshold
+    for (int i = 0; i < 100; ++i) {
+        x.set("field" + std::to_string(i), i);
+        EXPECT_EQ(x["field0"], 0);
+        EXPECT_EQ(x["foo"], json::String{"bar"});
+    }
+    for (int i = 0; i < 100; ++i)
+        x.set("field" + std::to_string(i), i);
+    EXPECT_EQ(x.size(), 103u);
+    EXPECT_EQ(x.key(53), "field50");
+    EXPECT_EQ(x["field77"], 77);
+    x.set("field77", "seventy seven");
+    EXPECT_EQ(x.size(), 103u);
+    EXPECT_EQ(x[80], json::String{"seventy seven"});
+    json::Struct const y{x};
+    EXPECT(y == x);
+    EXPECT_EQ(y["field99"], 99);
+    EXPECT_EQ(y["field100"], json::undefined);
 }
 
 TEST(json, parse) {
@@ -1222,4 +5261,784 @@ TEST(json, parseComments) {
 
 }
 
+TEST(json, parseStream) {
+    std::stringstream s{"{ \"foo\" : [1, 2.5, \"bar\"] }"};
+    json::Value v = json::parse(s);
+    EXPECT_EQ(STR(v), "{\"foo\" : [1, 2.5, \"bar\"]}");
+    // large input that spans multiple buffer fills
+    std::string large{"["};
+    for (size_t i = 0; i < 100000; ++i)
+        large += "\"foobar\", 12, ";
+    large += "]";
+    std::stringstream s2{large};
+    v = json::parse(s2);
+    EXPECT_EQ(STR(v), STR(json::parse(large)));
+}
+
+TEST(json, parseErrors) {
+    try {
+        json::parse("[1,\n  2,\n  \"foo");
+        EXPECT(false);
+    } catch (json::Error const & e) {
+        EXPECT_EQ(e.line, 3u);
+        EXPECT_EQ(e.col, 7u);
+    }
+    try {
+        json::parse("[1 2]");
+        EXPECT(false);
+    } catch (json::Error const & e) {
+        EXPECT_EQ(e.line, 1u);
+    }
+}
+
+TEST(json, parseFile) {
+    char const * filename = "json_parseFile_test.json";
+    {
+        std::ofstream f{filename};
+        f << "// config\n{ \"foo\" : [1, 2], \"bar\" : \"baz\" }";
+    }
+    json::Value v = json::parseFile(filename);
+    EXPECT_EQ(STR(v), "{\"foo\" : [1, 2], \"bar\" : \"baz\"}");
+    EXPECT_EQ(v.comment(), " config");
+    std::remove(filename);
+    try {
+        json::parseFile(filename);
+        EXPECT(false);
+    } catch (std::system_error const & e) {
+        EXPECT(e.code() == std::errc::no_such_file_or_directory);
+    }
+}
+
+TEST(json, whitespaceIndex) {
+    std::string block;
+    for (size_t i = 0; i < 64; ++i)
+        block += " \t\n\rx{\"/"[(i * 7 + i / 5) % 8];
+    EXPECT_EQ(json::detail::whitespaceMask(block.c_str()), json::detail::whitespaceMaskScalar(block.c_str()));
+    // indented input so that whitespace runs span multiple blocks
+    std::string input{"["};
+    std::string expected{"["};
+    for (size_t i = 0; i < 100; ++i) {
+        input += "\n" + std::string(i, ' ') + "\"a" + std::to_string(i) + "\" ,\t[ 1 ,\r\n 2 ],";
+        expected += (i == 0 ? "\"a" : ", \"a") + std::to_string(i) + "\", [1, 2]";
+    }
+    input += "\n]";
+    expected += "]";
+    EXPECT_EQ(STR(json::parse(input)), expected);
+}
+
+TEST(json, parseStrings) {
+    std::string long_(1000, 'x');
+    json::Value v = json::parse("\"" + long_ + "\"");
+    EXPECT_EQ(v, json::String{long_});
+    v = json::parse("'" + long_ + "\\n\\t\\'\\\"" + long_ + "'");
+    EXPECT_EQ(v, json::String{long_ + "\n\t'\"" + long_});
+    v = json::parse("\"it's\"");
+    EXPECT_EQ(v, json::String{"it's"});
+    std::stringstream s{"[\"" + long_ + "\\\\\", \"" + long_ + "\"]"};
+    v = json::parse(s);
+    EXPECT_EQ(STR(v), "[\"" + long_ + "\\\\\", \"" + long_ + "\"]");
+}
+
+TEST(json, parseNumbers) {
+    EXPECT_EQ(json::parse("0"), json::Int{0});
+    EXPECT_EQ(json::parse("10"), json::Int{10});
+    EXPECT_EQ(STR(json::parse("[10, 20, 0.5]")), "[10, 20, 0.5]");
+    EXPECT_EQ(json::parse("2147483648"), json::Int64{2147483648});
+    EXPECT_EQ(json::parse("-9223372036854775808"), json::Int64{std::numeric_limits<int64_t>::min()});
+    EXPECT_EQ(json::parse("9223372036854775807"), json::Int64{std::numeric_limits<int64_t>::max()});
+    EXPECT_EQ(json::parse("1700000000123456789"), json::Int64{1700000000123456789});
+    // integers above INT64_MAX are exact as long as they fit 64 bits unsigned
+    EXPECT_EQ(json::parse("9223372036854775808"), json::UInt64{uint64_t{1} << 63});
+    EXPECT_EQ(json::parse("18446744073709551615"), json::UInt64{std::numeric_limits<uint64_t>::max()});
+    EXPECT_EQ(STR(json::parse("18446744073709551615")), "18446744073709551615");
+    EXPECT_EQ(json::parse("18446744073709551616"), json::Double{18446744073709551616.0});
+    EXPECT_EQ(json::parse("-9223372036854775809"), json::Double{-9223372036854775809.0});
+    EXPECT_EQ(json::parse("-0.5"), json::Double{-0.5});
+    EXPECT_EQ(json::parse("1e3"), json::Double{1000});
+    EXPECT_EQ(json::parse("1E-2"), json::Double{0.01});
+    EXPECT_EQ(json::parse("2.5e+2"), json::Double{250});
+    EXPECT_EQ(json::parse("0.1"), json::Double{0.1});
+    EXPECT_EQ(json::parse("0.000001234"), json::Double{0.000001234});
+    EXPECT_EQ(json::parse("12e30"), json::Double{12e30});
+    EXPECT_EQ(json::parse("3.14159265358979323846264338327950288"), json::Double{3.14159265358979323846264338327950288});
+    EXPECT_EQ(json::parse("1.7976931348623157e308"), json::Double{1.7976931348623157e308});
+    EXPECT_EQ(json::parse("4.9406564584124654e-324"), json::Double{4.9406564584124654e-324});
+    EXPECT_EQ(json::parse("1e400"), json::Double{std::numeric_limits<double>::infinity()});
+    EXPECT_EQ(json::parse("1e-400"), json::Double{0});
+    // round trip of random doubles
+    uint64_t x = 88172645463325252;
+    for (size_t i = 0; i < 10000; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        double d;
+        std::memcpy(&d, &x, sizeof(double));
+        if (d != d || d == std::numeric_limits<double>::infinity() || d == -std::numeric_limits<double>::infinity())
+            continue;
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.16e", d);
+        EXPECT_EQ(json::parse(buf), json::Double{d});
+    }
+    // number split between two stream reads
+    std::stringstream s{std::string(256 * 1024 - 3, ' ') + "123456.5"};
+    EXPECT_EQ(json::parse(s), json::Double{123456.5});
+}
+
+TEST(json, parseInSitu) {
+    std::string input{"[\"foo\", \"b\\\"ar\", 'baz']"};
+    json::Value v = json::parseInSitu(input);
+    EXPECT_EQ(STR(v), "[\"foo\", \"b\\\"ar\", \"baz\"]");
+    json::Value foo = json::parseInSitu(std::string_view{input}.substr(1, 5));
+    EXPECT(foo.as<json::String>().borrowed());
+    EXPECT(foo.as<json::String>().view().data() == input.data() + 2);
+    json::Value copy{foo};
+    EXPECT(! copy.as<json::String>().borrowed());
+    EXPECT_EQ(copy, foo);
+    json::Value escaped = json::parseInSitu("\"b\\\"ar\"");
+    EXPECT(! escaped.as<json::String>().borrowed());
+    // borrowed strings are not null terminated
+    try {
+        foo.as<json::String>().c_str();
+        EXPECT(false);
+    } catch (std::logic_error const &) {
+    }
+    EXPECT_EQ(std::string{copy.as<json::String>().c_str()}, "foo");
+}
+
+TEST(json, Document) {
+    json::Document d = json::Document::parse("\"foo\"");
+    json::Document moved{std::move(d)};
+    EXPECT(moved.root().as<json::String>().borrowed());
+    EXPECT_EQ(moved.root(), json::String{"foo"});
+    char const * filename = "json_Document_test.json";
+    {
+        std::ofstream f{filename};
+        f << "[\"foo\", \"bar\"]";
+    }
+    json::Document f = json::Document::parseFile(filename);
+    std::remove(filename);
+    EXPECT_EQ(STR(f.root()), "[\"foo\", \"bar\"]");
+}
+
+namespace {
+    /** Handler that records all events in a string. 
+     */
+    class JsonEventRecorder {
+    public:
+        std::stringstream events;
+        void onUndefined() { events << "undefined "; }
+        void onNull() { events << "null "; }
+        void onBool(bool value) { events << (value ? "true " : "false "); }
+        void onInt(int64_t value) { events << "int:" << value << " "; }
+        void onUInt(uint64_t value) { events << "uint:" << value << " "; }
+        void onDouble(double value) { events << "double:" << value << " "; }
+        void onString(std::string_view value) { events << "string:" << value << " "; }
+        void onKey(std::string_view name) { events << "key:" << name << " "; }
+        void onStartArray() { events << "[ "; }
+        void onEndArray() { events << "] "; }
+        void onStartStruct() { events << "{ "; }
+        void onEndStruct() { events << "} "; }
+        void onComment(std::string_view comment) { events << "comment:" << comment << " "; }
+    }; 
+}
+
+TEST(json, parseEvents) {
+    JsonEventRecorder r;
+    json::parse("{ \"foo\" : [1, 2.5, 'bar', null, undefined, true,], bar : /*c*/ {}, \"x\\\"\" : 9000000000 }", r);
+    EXPECT_EQ(r.events.str(), "{ key:foo [ int:1 double:2.5 string:bar null undefined true ] key:bar comment:c { } key:x\" int:9000000000 } ");
+    JsonEventRecorder r2;
+    std::stringstream s{"[[], {}]"};
+    json::parse(s, r2);
+    EXPECT_EQ(r2.events.str(), "[ [ ] { } ] ");
+    JsonEventRecorder big;
+    json::parse("[9223372036854775807, 9223372036854775808]", big);
+    EXPECT_EQ(big.events.str(), "[ int:9223372036854775807 uint:9223372036854775808 ] ");
+    JsonEventRecorder r3;
+    try {
+        json::parse("[1, 2", r3);
+        EXPECT(false);
+    } catch (json::Error const &) {
+        EXPECT_EQ(r3.events.str(), "[ int:1 int:2 ");
+    }
+}
+
+TEST(json, Reader) {
+    using Kind = json::Reader::Kind;
+    json::Reader r{"[ { \"id\" : 1, \"tags\" : [\"a\", [\"b\"]], \"name\" : 'foo' }, /* second */ { id: 2, name: \"bar\", } ]"};
+    EXPECT(r.next() == Kind::StartArray);
+    EXPECT(r.next() == Kind::StartStruct);
+    EXPECT(r.next() == Kind::Key);
+    EXPECT_EQ(r.asString(), "id");
+    EXPECT(r.next() == Kind::Int);
+    EXPECT_EQ(r.asInt(), 1);
+    EXPECT(r.next() == Kind::Key);
+    EXPECT_EQ(r.asString(), "tags");
+    r.skip();
+    EXPECT(r.next() == Kind::Key);
+    EXPECT_EQ(r.value(), json::String{"foo"});
+    EXPECT(r.next() == Kind::EndStruct);
+    EXPECT(r.next() == Kind::StartStruct);
+    EXPECT_EQ(r.comment(), " second ");
+    EXPECT_EQ(r.depth(), 2u);
+    json::Value v = r.value();
+    EXPECT_EQ(v.comment(), " second ");
+    EXPECT_EQ(STR(v), "{\"id\" : 2, \"name\" : \"bar\"}");
+    EXPECT(r.kind() == Kind::EndStruct);
+    EXPECT(r.next() == Kind::EndArray);
+    EXPECT(r.next() == Kind::End);
+    EXPECT_EQ(r.depth(), 0u);
+    // skipping records from a stream
+    std::string large{"["};
+    for (size_t i = 0; i < 20000; ++i)
+        large += "{ \"id\" : " + std::to_string(i) + ", \"payload\" : [\"foobarbaz]\", {\"x\" : [1, 2, 3]}] },";
+    large += "]";
+    std::stringstream s{large};
+    json::Reader rs{s};
+    rs.next();
+    int64_t sum = 0;
+    while (rs.next() == Kind::StartStruct) {
+        while (rs.next() == Kind::Key) {
+            if (rs.asString() == "id") {
+                rs.next();
+                sum += rs.asInt();
+            } else {
+                rs.skip();
+            }
+        }
+    }
+    EXPECT(rs.kind() == Kind::EndArray);
+    EXPECT_EQ(sum, int64_t{20000} * 19999 / 2);
+    // errors
+    json::Reader re{"[1 2]"};
+    re.next();
+    re.next();
+    try {
+        re.next();
+        EXPECT(false);
+    } catch (json::Error const & e) {
+        EXPECT_EQ(std::string{e.what()}, "Expected , or ]");
+    }
+}
+
+TEST(json, Lazy) {
+    std::string input{"{ \"id\" : 7, \"items\" : // skipped\n [1, [2, 3], { \"a\" : \"]\" }], big : 12345678901, name : /* foo */ 'foo', }"};
+    json::Lazy doc{input};
+    EXPECT(doc.kind() == json::Value::Kind::Struct);
+    EXPECT_EQ(doc["id"].value(), 7);
+    EXPECT(doc["items"].kind() == json::Value::Kind::Array);
+    EXPECT_EQ(STR(doc["items"][1].value()), "[2, 3]");
+    EXPECT_EQ(doc["items"][2]["a"].value(), json::String{"]"});
+    EXPECT(doc["items"][3].kind() == json::Value::Kind::Undefined);
+    EXPECT(doc["items"][2]["missing"].kind() == json::Value::Kind::Undefined);
+    // missing values are shared, so they can not be modified
+    static_assert(std::is_same_v<decltype(doc["missing"]), json::Lazy const &>);
+    EXPECT_EQ(&doc["missing"], &doc["items"][7]);
+    EXPECT_EQ(doc["name"].value(), json::String{"foo"});
+    EXPECT_EQ(doc["big"].value(), json::Int64{12345678901});
+    EXPECT_EQ(doc.size(), 4u);
+    EXPECT_EQ(doc.key(2), "big");
+    EXPECT_EQ(doc["items"].size(), 3u);
+    EXPECT_EQ(STR(doc.value()), STR(json::parse(input)));
+    // errors are only reported for the scanned parts
+    json::Lazy bad{"[1, 2 3]"};
+    EXPECT_EQ(bad[1].value(), 2);
+    try {
+        bad[2];
+        EXPECT(false);
+    } catch (json::Error const & e) {
+        EXPECT_EQ(std::string{e.what()}, "Expected , or ]");
+        EXPECT_EQ(e.col, 8u);
+    }
+}
+
+TEST(json, ChunkedParser) {
+    std::string input{"// head\n{ \"a\\\"b\" : [1, -2.5e3, 12345678901, true, null], name : /* c */ 'x\\ny', \"empty\" : {}, }"};
+    std::string expected = STR(json::parse(input));
+    // every split into chunks of given size must give the same result
+    for (size_t size = 1; size <= input.size(); ++size) {
+        json::ChunkedParser<> p;
+        for (size_t i = 0; i < input.size(); i += size) {
+            EXPECT(! p.done());
+            p.feed(input.data() + i, std::min(size, input.size() - i));
+        }
+        EXPECT(p.done());
+        json::Value v = p.handler().take();
+        EXPECT_EQ(STR(v), expected);
+        EXPECT_EQ(v.comment(), " head");
+    }
+    // values following each other
+    json::ChunkedParser<> p;
+    std::string_view stream{"[1] {\"x\" : 2}  37"};
+    size_t n = p.feed(stream);
+    EXPECT_EQ(n, 3u);
+    EXPECT_EQ(STR(p.handler().take()), "[1]");
+    p.reset();
+    stream.remove_prefix(n);
+    stream.remove_prefix(p.feed(stream));
+    EXPECT_EQ(STR(p.handler().take()), "{\"x\" : 2}");
+    p.reset();
+    p.feed(stream);
+    EXPECT(! p.done());
+    p.finish();
+    EXPECT_EQ(p.handler().take(), 37);
+    // errors
+    json::ChunkedParser<> e;
+    e.feed("[1,\n \"ab");
+    try {
+        e.feed("c\" 2]");
+        EXPECT(false);
+    } catch (json::Error const & err) {
+        EXPECT_EQ(std::string{err.what()}, "Expected , or ]");
+        EXPECT_EQ(err.line, 2u);
+        EXPECT_EQ(err.col, 8u);
+    }
+}
+
+namespace {
+    /** Memory resource that counts the allocations it passes to the heap. 
+     */
+    class JsonCountingResource : public std::pmr::memory_resource {
+    public:
+        size_t allocations = 0;
+    private:
+        void * do_allocate(size_t bytes, size_t alignment) override {
+            ++allocations;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void * p, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override {
+            return this == &other;
+        }
+    };
+}
+
+TEST(json, DocumentArena) {
+    std::string input{"["};
+    for (size_t i = 0; i < 1000; ++i)
+        input += "{ \"id\" : " + std::to_string(i) + ", \"tags\" : [\"a\\tb\", \"c\"] },";
+    input += "]";
+    std::string expected = STR(json::parse(input));
+    JsonCountingResource counter;
+    std::pmr::memory_resource * old = std::pmr::set_default_resource(&counter);
+    json::Value copy;
+    size_t allocations = 0;
+    {
+        json::Document d = json::Document::parse(input);
+        // only the arena blocks come from the heap
+        allocations = counter.allocations;
+        copy = d.root();
+    }
+    std::pmr::set_default_resource(old);
+    EXPECT(allocations < 20);
+    EXPECT(counter.allocations > allocations + 1000);
+    EXPECT_EQ(STR(copy), expected);
+    // strings with escapes are copied to the arena
+    json::Document d = json::Document::parse("\"a\\tb\"");
+    EXPECT(d.root().as<json::String>().borrowed());
+    EXPECT_EQ(d.root(), json::String{"a\tb"});
+    json::Value s = d.root();
+    EXPECT(! s.as<json::String>().borrowed());
+}
+
+TEST(json, KeyTable) {
+    json::KeyTable keys;
+    json::Value a = json::parse("{ \"id\" : 1, \"name\" : \"foo\", id : 2 }", keys);
+    json::Value b = json::parse("{ \"name\" : \"bar\", \"id\" : 3 }", keys);
+    EXPECT_EQ(keys.size(), 2u);
+    EXPECT_EQ(STR(a), "{\"id\" : 2, \"name\" : \"foo\"}");
+    EXPECT_EQ(STR(b), "{\"name\" : \"bar\", \"id\" : 3}");
+    EXPECT_EQ(keys.intern("id").name().data(), keys.intern(std::string{"id"}).name().data());
+    // copies own their names and are independent of the table
+    json::Value c;
+    {
+        json::KeyTable temp;
+        c = json::parse("{ \"some rather long field name\" : [{ \"x\" : 1 }, { \"x\" : 2 }] }", temp);
+        EXPECT_EQ(temp.size(), 2u);
+        c = json::Value{c};
+    }
+    EXPECT_EQ(STR(c), "{\"some rather long field name\" : [{\"x\" : 1}, {\"x\" : 2}]}");
+    // names interned in different tables are still the same names
+    json::KeyTable other;
+    a.as<json::Struct>()[other.intern("id")] = json::Value{4};
+    a.as<json::Struct>()[other.intern("extra")] = json::Value{5};
+    a.as<json::Struct>()[keys.intern("extra")] = json::Value{6};
+    EXPECT_EQ(STR(a), "{\"id\" : 4, \"name\" : \"foo\", \"extra\" : 6}");
+}
+
+TEST(json, Comments) {
+    // values without comments pay nothing for them
+    EXPECT_EQ(sizeof(json::Value), 16u);
+    json::Value v = json::parse("/* outer */ [ /* inner */ 1, 2]");
+    EXPECT_EQ(v.comment(), " outer ");
+    json::Value copy{v};
+    v.setComment("changed");
+    EXPECT_EQ(copy.comment(), " outer ");
+    EXPECT_EQ(v.comment(), "changed");
+    json::Value moved{std::move(copy)};
+    EXPECT_EQ(moved.comment(), " outer ");
+    moved.setComment("");
+    EXPECT(moved.comment().empty());
+    json::Int i{3};
+    i.setComment("three");
+    json::Int j{4};
+    j = i;
+    EXPECT_EQ(j.comment(), "three");
+    EXPECT_EQ(static_cast<int>(j), 3);
+    // every kind keeps its value while it has a comment
+    json::Value all = json::parse("[/*u*/ undefined, /*n*/ null, /*b*/ true, /*i*/ 1, /*l*/ 12345678901, /*d*/ 1.5, /*s*/ 'short', /*t*/ 'a longer string', /*a*/ [], /*o*/ {}]");
+    json::Value allCopy{all};
+    EXPECT_EQ(STR(allCopy), "[undefined, null, true, 1, 12345678901, 1.5, \"short\", \"a longer string\", [], {}]");
+    std::string comments;
+    for (json::Value const & x : allCopy.as<json::Array>())
+        comments += x.comment();
+    EXPECT_EQ(comments, "unbildstao");
+    for (json::Value & x : all.as<json::Array>())
+        x.setComment("");
+    EXPECT_EQ(STR(all), STR(allCopy));
+    EXPECT_EQ(all.as<json::Array>()[6].as<json::String>().view(), "short");
+    EXPECT(all.as<json::Array>()[9].comment().empty());
+}
+
+TEST(json, CompactValue) {
+    EXPECT_EQ(sizeof(json::Value), 16u);
+    json::Value v = json::parse("[\"a\", \"\", 1.5, 2, 3000000000, true, null, {\"b\" : []}]");
+    EXPECT_EQ(STR(v), "[\"a\", \"\", 1.5, 2, 3000000000, true, null, {\"b\" : []}]");
+    json::Value copy{v};
+    v = json::Value{json::String{"replaced"}};
+    EXPECT_EQ(STR(copy), "[\"a\", \"\", 1.5, 2, 3000000000, true, null, {\"b\" : []}]");
+    // assigning a part of the value to itself must not free it first
+    copy = copy.as<json::Array>()[7];
+    EXPECT_EQ(STR(copy), "{\"b\" : []}");
+    json::String const s{std::string{"owned"}};
+    EXPECT_EQ(std::strlen(s.c_str()), 5u);
+    EXPECT(json::Bool{true} != json::Bool{false});
+}
+
+TEST(json, InlineString) {
+    json::String a{"short"};
+    json::String b{"a somewhat longer string"};
+    EXPECT_EQ(std::string{a.c_str()}, "short");
+    EXPECT_EQ(std::string{b.c_str()}, "a somewhat longer string");
+    json::String c{std::move(a)};
+    EXPECT_EQ(c.view(), "short");
+    EXPECT_EQ(a.size(), 0u);
+    a = b;
+    b = c;
+    EXPECT_EQ(a.view(), "a somewhat longer string");
+    EXPECT_EQ(b.view(), "short");
+    // copies of borrowed short strings are inline and terminated
+    std::string buffer{"abcdefgh"};
+    json::String borrowed = json::String::borrow(std::string_view{buffer}.substr(0, 3));
+    json::String d{borrowed};
+    EXPECT_EQ(std::string{d.c_str()}, "abc");
+    EXPECT(! d.borrowed());
+    buffer[0] = 'x';
+    EXPECT_EQ(d.view(), "abc");
+    json::Value v = json::parse("{\"id\" : \"1234567\", \"name\" : \"12345678\"}");
+    EXPECT_EQ(STR(v), "{\"id\" : \"1234567\", \"name\" : \"12345678\"}");
+    // strings up to MaxInlineSize characters are stored in the object itself, longer ones are allocated
+    auto isInline = [](json::String const & s) {
+        char const * p = s.view().data();
+        return p >= reinterpret_cast<char const *>(&s) && p < reinterpret_cast<char const *>(&s + 1);
+    };
+    EXPECT_EQ(json::String::MaxInlineSize, 14u);
+    std::string longest(json::String::MaxInlineSize, 'x');
+    json::String full{longest};
+    EXPECT(isInline(full));
+    EXPECT_EQ(full.view(), longest);
+    EXPECT_EQ(std::string{full.c_str()}, longest);
+    EXPECT(! isInline(json::String{longest + "x"}));
+    EXPECT(isInline(json::String{""}));
+    EXPECT(isInline(json::String{"2026-10-16"}));
+    // a comment moves the characters out of line, removing it moves them back
+    full.setComment("full");
+    EXPECT(! isInline(full));
+    EXPECT_EQ(full.view(), longest);
+    full.setComment("");
+    EXPECT(isInline(full));
+    EXPECT_EQ(full.view(), longest);
+}
+
+TEST(json, CopyOnWrite) {
+    json::Value v = json::parse("{\"a\" : [1, 2, {\"b\" : [3]}], \"c\" : [\"some long string\"]}");
+    json::Value copy{v};
+    json::Value const & cv = v;
+    json::Value const & cc = copy;
+    // copies share the subtrees until modified
+    EXPECT_EQ(&cv.as<json::Struct>()["a"], &cc.as<json::Struct>()["a"]);
+    copy.as<json::Struct>()["a"].as<json::Array>()[2].as<json::Struct>()["b"].as<json::Array>().add(json::Value{4});
+    EXPECT_EQ(STR(v), "{\"a\" : [1, 2, {\"b\" : [3]}], \"c\" : [\"some long string\"]}");
+    EXPECT_EQ(STR(copy), "{\"a\" : [1, 2, {\"b\" : [3, 4]}], \"c\" : [\"some long string\"]}");
+    // untouched subtrees are still shared
+    EXPECT(&cv.as<json::Struct>()["a"] != &cc.as<json::Struct>()["a"]);
+    EXPECT_EQ(cv.as<json::Struct>()["c"].as<json::Array>().begin(), cc.as<json::Struct>()["c"].as<json::Array>().begin());
+    // copies of values with borrowed strings own them
+    json::Value x;
+    {
+        std::string input{"[\"borrowed from the input\"]"};
+        json::Value y = json::parseInSitu(input);
+        x = y;
+    }
+    EXPECT_EQ(STR(x), "[\"borrowed from the input\"]");
+    // references taken before copying must not modify the copy
+    json::Array a;
+    a.add(json::Value{1});
+    a.add(json::Value{2});
+    json::Value & e = a[0];
+    json::Array b = a;
+    e = json::Value{42};
+    EXPECT_EQ(STR(a), "[42, 2]");
+    EXPECT_EQ(STR(b), "[1, 2]");
+    json::Struct s;
+    s.set("x", json::Value{1});
+    json::Value & f = s["x"];
+    json::Struct t = s;
+    f = json::Value{42};
+    EXPECT_EQ(STR(s), "{\"x\" : 42}");
+    EXPECT_EQ(STR(t), "{\"x\" : 1}");
+    json::Value * i = a.begin();
+    json::Array c = a;
+    *i = json::Value{7};
+    EXPECT_EQ(STR(c), "[42, 2]");
+    // containers holding moved in values that borrow the input are not shared by their copies either
+    json::Value outerCopy;
+    json::Value fieldsCopy;
+    {
+        std::string input{"[\"borrowed from the input\"]"};
+        std::string str{"\"borrowed string\""};
+        json::Array outer;
+        outer.add(json::parseInSitu(input));
+        outer.add(json::parseInSitu(str));
+        json::Struct fields;
+        fields.set("x", json::parseInSitu(input));
+        outerCopy = json::Value{json::Array{outer}};
+        fieldsCopy = json::Value{json::Struct{fields}};
+    }
+    EXPECT_EQ(STR(outerCopy), "[[\"borrowed from the input\"], \"borrowed string\"]");
+    EXPECT_EQ(STR(fieldsCopy), "{\"x\" : [\"borrowed from the input\"]}");
+}
+
+TEST(json, Tape) {
+    std::string input{"{ \"items\" : [{ \"price\" : 1.5, tags : [] }, { \"price\" : 2, \"tags\" : [\"a\", 'b'] }], \"id\" : 9000000000, \"ok\" : true, \"none\" : null, \"u\" : /* c */ undefined }"};
+    json::Tape doc{input};
+    json::TapeView root = doc.root();
+    EXPECT(root.kind() == json::Value::Kind::Struct);
+    EXPECT_EQ(root.size(), 5u);
+    EXPECT_EQ(root.key(1), "id");
+    EXPECT_EQ(root["id"].asInt(), 9000000000);
+    EXPECT(root["ok"].asBool());
+    EXPECT(root["none"].kind() == json::Value::Kind::Null);
+    EXPECT(root["missing"].kind() == json::Value::Kind::Undefined);
+    double total = 0;
+    size_t tags = 0;
+    for (json::TapeView item : root["items"]) {
+        total += item["price"].asDouble();
+        tags += item["tags"].size();
+    }
+    EXPECT_EQ(total, 3.5);
+    EXPECT_EQ(tags, 2u);
+    EXPECT_EQ(root["items"][1]["tags"][1].asString(), "b");
+    EXPECT(root["items"][2].kind() == json::Value::Kind::Undefined);
+    EXPECT_EQ(STR(root.value()), STR(json::parse(input)));
+    json::Tape big{"[18446744073709551615]"};
+    EXPECT(big.root()[0].kind() == json::Value::Kind::UInt64);
+    EXPECT_EQ(big.root()[0].asUInt(), std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(STR(big.root().value()), "[18446744073709551615]");
+}
+
+TEST(json, Serializer) {
+    std::string input{"{\"a\" : [1, -2147483648, -9223372036854775808, 1.5, 1e+20, true, null, undefined], \"b\" : {\"c\" : \"d\", \"e\" : []}}"};
+    json::Value v = json::parse(input);
+    json::Serializer s;
+    s << v;
+    EXPECT_EQ(s.view(), input);
+    EXPECT_EQ(s.take(), STR(v));
+    EXPECT(s.view().empty());
+    // small buffer passes the output to the sink in chunks
+    std::string output;
+    size_t chunks = 0;
+    {
+        json::Serializer sink{[&](char const * data, size_t size) { output.append(data, size); ++chunks; }, 16};
+        sink << v;
+    }
+    EXPECT_EQ(output, input);
+    EXPECT(chunks > 1);
+}
+
+TEST(json, NumberFormatting) {
+    EXPECT_EQ(STR(json::Int{0}), "0");
+    EXPECT_EQ(STR(json::Int{9}), "9");
+    EXPECT_EQ(STR(json::Int{10}), "10");
+    EXPECT_EQ(STR(json::Int{-100}), "-100");
+    EXPECT_EQ(STR(json::Int{1234567}), "1234567");
+    EXPECT_EQ(STR(json::Int64{std::numeric_limits<int64_t>::min()}), "-9223372036854775808");
+    EXPECT_EQ(STR(json::Int64{std::numeric_limits<int64_t>::max()}), "9223372036854775807");
+    EXPECT_EQ(STR(json::Double{0.1}), "0.1");
+    EXPECT_EQ(STR(json::Double{3}), "3.0");
+    EXPECT_EQ(STR(json::Double{-0.0}), "-0.0");
+    EXPECT_EQ(STR(json::Double{1e21}), "1e+21");
+    // non-finite values are not valid JSON
+    EXPECT_EQ(STR(json::Double{std::numeric_limits<double>::quiet_NaN()}), "null");
+    EXPECT_EQ(STR(json::Double{std::numeric_limits<double>::infinity()}), "null");
+    EXPECT_EQ(STR(json::Value{-std::numeric_limits<double>::infinity()}), "null");
+    EXPECT(json::parse(STR(json::Value{std::numeric_limits<double>::infinity()})).kind() == json::Value::Kind::Null);
+    // doubles round trip exactly and keep their kind
+    for (double x : { 1.0 / 3, 0.1 + 0.2, 5e-324, 1.7976931348623157e308, -123456.789e-200, 9007199254740993.0 }) {
+        json::Value v = json::parse(STR(json::Double{x}));
+        EXPECT(v.kind() == json::Value::Kind::Double);
+        EXPECT_EQ(static_cast<double>(v.as<json::Double>()), x);
+    }
+}
+
+TEST(json, StringEscaping) {
+    std::string raw{"quote \" backslash \\ newline \n tab \t bell \x07 / \xc3\xa9"};
+    EXPECT_EQ(STR(json::String{raw}), "\"quote \\\" backslash \\\\ newline \\n tab \\t bell \\u0007 / \xc3\xa9\"");
+    EXPECT_EQ(json::parse(STR(json::String{raw})).as<json::String>().view(), raw);
+    EXPECT_EQ(STR(json::parse("{\"a\\\"b\" : 1}")), "{\"a\\\"b\" : 1}");
+    EXPECT_EQ(json::parse("\"\\u00e9\\u20ac\\ud83d\\ude00\\/\\b\\f\"").as<json::String>().view(), "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80/\b\f");
+    for (char const * invalid : { "\"\\ud83d\"", "\"\\ude00\"", "\"\\u12g4\"" }) {
+        try {
+            json::parse(invalid);
+            EXPECT(false);
+        } catch (json::Error const &) {
+        }
+    }
+    // the vectorized search finds the same character as the scalar loop at every position
+    for (size_t i = 0; i < 70; ++i) {
+        std::string s(70, 'x');
+        s[i] = '\x1f';
+        EXPECT_EQ(json::detail::findEscape(s.data(), s.data() + s.size()) - s.data(), static_cast<ptrdiff_t>(i));
+        s[i] = '\x7f';
+        EXPECT_EQ(json::detail::findEscape(s.data(), s.data() + s.size()) - s.data(), 70);
+    }
+}
+
+TEST(json, PrettyPrint) {
+    json::Value v = json::parse("/* config */ {\"name\" : \"x\", \"servers\" : [{\"host\" : \"a\", \"port\" : 80}, {\"host\" : \"b\", \"port\" : /* default */ 8080}], \"empty\" : [], \"debug\" : // off */\n false}");
+    json::Serializer s{json::Serializer::Format{2, 30, true, true}};
+    s << v;
+    std::string expected = 
+        "/* config */ {\n"
+        "  \"debug\" : // off */\n"
+        "  false,\n"
+        "  \"empty\" : [],\n"
+        "  \"name\" : \"x\",\n"
+        "  \"servers\" : [\n"
+        "    {\"host\" : \"a\", \"port\" : 80},\n"
+        "    {\n"
+        "      \"host\" : \"b\",\n"
+        "      \"port\" : /* default */ 8080\n"
+        "    }\n"
+        "  ]\n"
+        "}";
+    EXPECT_EQ(s.view(), expected);
+    // comments round trip
+    json::Serializer again{json::Serializer::Format{2, 30, true, true}};
+    again << json::parse(s.take());
+    EXPECT_EQ(again.view(), expected);
+    // multi-line comments that cannot be block comments round trip as consecutive line comments
+    json::Value multi{1};
+    multi.setComment("first */\nsecond\nthird");
+    json::Serializer lines{json::Serializer::Format{0, 0, false, true}};
+    lines << multi;
+    EXPECT_EQ(lines.view(), "//first */\n//second\n//third\n1");
+    EXPECT_EQ(json::parse(lines.view()).comment(), "first */\nsecond\nthird");
+    json::Reader reader{lines.view()};
+    reader.next();
+    EXPECT_EQ(reader.comment(), "first */\nsecond\nthird");
+    json::ChunkedParser<> chunked;
+    chunked.feed(lines.view());
+    chunked.finish();
+    EXPECT_EQ(chunked.handler().take().comment(), "first */\nsecond\nthird");
+    // without comments and sorting only the layout changes
+    json::Serializer plain{json::Serializer::Format{4, 0, false, false}};
+    plain << json::parse("[1, {\"b\" : 2, \"a\" : []}]");
+    EXPECT_EQ(plain.view(), "[\n    1,\n    {\n        \"b\" : 2,\n        \"a\" : []\n    }\n]");
+}
+
+TEST(json, Writer) {
+    json::Writer w;
+    w.beginStruct();
+    w.key("id");
+    w.value(int64_t{9000000000});
+    w.key("name");
+    w.value("a \"quoted\" name");
+    w.key("tags");
+    w.beginArray();
+    w.value(1);
+    w.value(2.5);
+    w.value(true);
+    w.null();
+    w.beginStruct();
+    w.endStruct();
+    w.endArray();
+    w.key("nested");
+    w.value(json::parse("[{\"x\" : []}]"));
+    w.endStruct();
+    std::string output = w.take();
+    EXPECT_EQ(output, "{\"id\" : 9000000000, \"name\" : \"a \\\"quoted\\\" name\", \"tags\" : [1, 2.5, true, null, {}], \"nested\" : [{\"x\" : []}]}");
+    EXPECT_EQ(STR(json::parse(output)), output);
+#if (defined __unix__) || (defined __APPLE__)
+    FILE * f = std::tmpfile();
+    {
+        json::Writer fw{json::Serializer::fileSink(fileno(f)), 4};
+        fw.beginArray();
+        for (int i = 0; i < 10; ++i)
+            fw.value(i);
+        fw.endArray();
+    }
+    std::rewind(f);
+    char buffer[64] = {};
+    size_t size = std::fread(buffer, 1, sizeof(buffer), f);
+    std::fclose(f);
+    EXPECT_EQ(std::string(buffer, size), "[0, 1, 2, 3, 4, 5, 6, 7, 8, 9]");
+#endif
+}
+
+TEST(json, NumberAtChunkBoundary) {
+    // the number ends exactly at the end of the first chunk read from the stream and of the input
+    for (size_t spaces : { 256 * 1024 - 6, 256 * 1024 - 5, 256 * 1024 - 3 }) {
+        std::stringstream s{std::string(spaces, ' ') + "123456"};
+        json::Value v = json::parse(s);
+        EXPECT(v.kind() == json::Value::Kind::Int);
+        EXPECT_EQ(static_cast<int>(v.as<json::Int>()), 123456);
+    }
+}
+
+TEST(json, DocumentReassign) {
+    json::Document doc = json::Document::parse("{\"a\" : [1, {\"b\" : \"a long enough string\"}], \"c\" : \"x\\ny\"}");
+    doc = json::Document::parse("[{\"d\" : \"another long enough string\"}]");
+    EXPECT_EQ(STR(doc.root()), "[{\"d\" : \"another long enough string\"}]");
+    json::Document other = std::move(doc);
+    EXPECT_EQ(STR(other.root()), "[{\"d\" : \"another long enough string\"}]");
+}
+
+TEST(json, ArrayAddInvalidation) {
+    json::Array a;
+    a.add(json::Value{std::string{"a string that is not inline"}});
+    // adding an element of the array itself while the array grows
+    for (int i = 0; i < 10; ++i)
+        a.add(a[0]);
+    a.add(std::move(a[1]));
+    EXPECT_EQ(a.size(), 12u);
+    EXPECT_EQ(STR(a[11]), "\"a string that is not inline\"");
+    EXPECT_EQ(STR(a[10]), "\"a string that is not inline\"");
+}
+
+TEST(json, StructFieldInvalidation) {
+    json::Struct s;
+    s["c"] = json::Value{std::string{"a string that is not inline"}};
+    json::Value & c = s["c"];
+    // adding fields while holding a reference to another one, across segment and index growth
+    for (int i = 0; i < 40; ++i)
+        s[std::to_string(i)] = s["c"];
+    s["b"] = s["c"];
+    EXPECT_EQ(&c, &s["c"]);
+    EXPECT_EQ(s.size(), 42u);
+    EXPECT_EQ(STR(s["b"]), "\"a string that is not inline\"");
+    EXPECT_EQ(STR(s["39"]), "\"a string that is not inline\"");
+}
+
 #endif